@@ -1,5 +1,10 @@
 #include "Nut.h"
 #include "gui/gui.h"
+#include "terrain/noise.h"
+#include "terrain/dem.h"
+#include "core/bench_report.h"
+#include "core/job_pool.h"
+#include "core/profiler.h"
 
 // STB Image
 #define STB_IMAGE_IMPLEMENTATION
@@ -13,32 +18,61 @@
 
 // STLs
 #include <iostream>
+#include <cstdio>
 #include <vector>
 #include <fstream>
 #include <sstream>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <random>
+#include <climits>
 
-// Vertex struct
-struct Vertex { glm::vec3 pos; glm::vec3 normal; glm::vec2 uv; };
+// Compiler flags of this binary, recorded in bench reports (set by the Makefile)
+#ifndef NUT_BUILD_FLAGS
+#define NUT_BUILD_FLAGS "unknown"
+#endif
 
 // Static instance pointer
 Engine* Engine::s_instance_ = nullptr;
 
 Engine::Engine()
-    : window_(nullptr), shaderProgram_(0), vao_(0), vbo_(0), ebo_(0), indexCount_(0), grassTexture_(0),
+    : window_(nullptr), headlessFbo_(0), headlessColor_(0), headlessDepth_(0), headlessW_(0), headlessH_(0), shaderProgram_(0), vao_(0), vbo_(0), ebo_(0), indexCount_(0), grassTexture_(0),
       panoramaTexture_(0), skyShader_(0), skyVAO_(0), skyVBO_(0),
       cameraPos_(0.0f, 6.0f, 12.0f), yaw_(-90.0f), pitch_(-15.0f), mouseSensitivity_(0.12f), moveSpeed_(6.0f),
-      lastX_(0.0), lastY_(0.0), firstMouse_(true), lastFrame_(Clock::now()), deltaTime_(0.0f), jumping_(false), jumpVel_(0.0f), vsyncEnabled_(true)
+      lastX_(0.0), lastY_(0.0), firstMouse_(true), lastFrame_(Clock::now()), deltaTime_(0.0f),
+      simClock_(60.0, 8), prevCameraPos_(0.0f, 6.0f, 12.0f), simRunning_(false), tickRate_(60.0f), simTickRate_(60.0f), maxSimSteps_(8),
+      agentTarget_(0), agentSeed_(1), agentMs_(0.0f), agentHash_(4.0f), broadphaseMs_(0.0f),
+      inputBaseTick_(0), replayDone_(false), benchThresholdPct_(10.0), jumping_(false), jumpVel_(0.0f), vsyncEnabled_(true)
 {
     std::fill(std::begin(keys_), std::end(keys_), false);
     s_instance_ = this;
+    frame_ = makeSimFrame(Clock::now());
+    lastViewProj_ = glm::mat4(1.0f); lastEye_ = cameraPos_;
+    renderThreadEnabled_ = true; renderRunning_ = false;
+    packetSeq_ = 0; swapInterval_ = -1; inputLatencyCount_ = 0;
 
     // Defaults for configurable constants and paths
     terrainSize_ = 512;
     terrainScale_ = 1.0f;
     heightScale_ = 6.0f;
     textureTile_ = 22.0f;
+    normalMode_ = NormalMode::Stencil;
+    tileBudgetMB_ = 256;
+    demLevel_ = 0;
+    demCenterX_ = demCenterZ_ = 0.0;
+    demBuildBusy_ = false; terrainGeneration_ = 0;
+    navUsed_ = navBuilding_ = false;
+    terrainRenderMode_ = TerrainRenderMode::Mesh;
+    heightTex_ = 0; heightTexSize_ = 0;
+    patchVAO_ = patchVBO_ = patchEBO_ = 0; patchIndexCount_ = 0;
+    gridOriginX_ = gridOriginZ_ = 0.0f; gridSpacing_ = 1.0f;
+    lastUploadBytes_ = 0; lastUploadMs_ = 0.0f;
+    heightBackend_ = HeightBackend::Cpu;
+    heightLayout_ = HeightLayout::RowMajor; // measured faster for point/stencil queries, see make bench
+    heightGenShader_ = heightGenFBO_ = heightGenTex_ = heightGenPBO_ = 0; heightGenSize_ = 0; heightGenFence_ = 0;
+    heightGenTimer_[0] = heightGenTimer_[1] = 0;
+    cpuGenMs_ = gpuGenMs_ = maxBackendError_ = 0.0f;
     panoramaPath_.clear();
     terrainTexturePath_.clear();
     // Cloud defaults
@@ -46,6 +80,14 @@ Engine::Engine()
     cloudSpeed_ = 0.02f;
     cloudScale_ = 1.0f;
     cloudOpacity_ = 0.55f;
+    terrainSentValid_ = skySentValid_ = depthSentValid_ = false;
+    depthProgram_ = 0;
+    skyLast_ = true; depthPrepass_ = false;
+    dynamicRes_ = false; upscaleProgram_ = 0; upscaleInvSizeLoc_ = -1;
+    sceneW_ = sceneH_ = 0;
+    gui_ = nullptr;
+    for (SceneQueries &q : sceneQueries_) { std::fill(std::begin(q.ids), std::end(q.ids), 0u); q.pending = false; }
+    skyFragments_ = terrainFragments_ = 0;
 
     // Create GUI manager (will be initialized after window/context creation)
     // gui_ = new GUI(this);
@@ -53,8 +95,23 @@ Engine::Engine()
 
 Engine::~Engine() {
     // Cleanup
+    stopSimulation();
+    // A DEM window or navigation job on JobPool still writes into this engine
+    for (;;) {
+        { std::lock_guard<std::mutex> lock(demBuildMutex_); if (!demBuildBusy_.load() || demBuildDone_) break; }
+        std::this_thread::yield();
+    }
+    for (;;) {
+        { std::lock_guard<std::mutex> lock(navMutex_); if (!navBuilding_) break; }
+        std::this_thread::yield();
+    }
     if (shaderProgram_) glDeleteProgram(shaderProgram_);
     if (skyShader_) glDeleteProgram(skyShader_);
+    if (depthProgram_) glDeleteProgram(depthProgram_);
+    if (upscaleProgram_) glDeleteProgram(upscaleProgram_);
+    graph_.destroy(gl_);
+    gpuTimer_.destroy();
+    for (SceneQueries &q : sceneQueries_) if (q.ids[0]) glDeleteQueries(SceneQueries::Count, q.ids);
     if (grassTexture_) glDeleteTextures(1, &grassTexture_);
     if (panoramaTexture_) glDeleteTextures(1, &panoramaTexture_);
     if (vbo_) glDeleteBuffers(1, &vbo_);
@@ -62,7 +119,22 @@ Engine::~Engine() {
     if (vao_) glDeleteVertexArrays(1, &vao_);
     if (skyVBO_) glDeleteBuffers(1, &skyVBO_);
     if (skyVAO_) glDeleteVertexArrays(1, &skyVAO_);
+    frameUbo_.destroy();
+    if (heightTex_) glDeleteTextures(1, &heightTex_);
+    if (heightGenFence_) glDeleteSync(heightGenFence_);
+    if (heightGenShader_) glDeleteProgram(heightGenShader_);
+    if (heightGenFBO_) glDeleteFramebuffers(1, &heightGenFBO_);
+    if (heightGenTex_) glDeleteTextures(1, &heightGenTex_);
+    if (heightGenPBO_) glDeleteBuffers(1, &heightGenPBO_);
+    if (heightGenTimer_[0]) glDeleteQueries(2, heightGenTimer_);
+    if (patchVBO_) glDeleteBuffers(1, &patchVBO_);
+    if (patchEBO_) glDeleteBuffers(1, &patchEBO_);
+    if (patchVAO_) glDeleteVertexArrays(1, &patchVAO_);
+    if (headlessFbo_) glDeleteFramebuffers(1, &headlessFbo_);
+    if (headlessColor_) glDeleteTextures(1, &headlessColor_);
+    if (headlessDepth_) glDeleteRenderbuffers(1, &headlessDepth_);
     if (window_) glfwTerminate();
+    headless_.destroy();
 
     // if (gui_) { delete gui_; gui_ = nullptr; }
 }
@@ -93,7 +165,8 @@ bool Engine::init(bool fullscreen) {
 
     // GLEW + GL context
     glfwMakeContextCurrent(window_);
-    glfwSwapInterval(vsyncEnabled_ ? 1 : 0);
+    swapInterval_ = vsyncEnabled_ ? 1 : 0;
+    glfwSwapInterval(swapInterval_);
     glewExperimental = GL_TRUE;
     if (glewInit() != GLEW_OK) return false;
 
@@ -102,13 +175,56 @@ bool Engine::init(bool fullscreen) {
     glfwSetCursorPosCallback(window_, Engine::cursorPosCallbackStatic);
     glfwSetKeyCallback(window_, Engine::keyCallbackStatic);
 
+    if (!initResources()) return false;
+
+    // Initialize GUI after the OpenGL context is created
+    // if (gui_) gui_->init(window_);
+
+    return true;
+}
+
+// Without a window: EGL context, offscreen colour + depth target as the
+// backbuffer, then the same resources as init()
+bool Engine::initHeadless(int width, int height) {
+    if (width <= 0 || height <= 0 || !headless_.create(3, 3)) return false;
+    glewExperimental = GL_TRUE;
+    // GLEW built for GLX loads the GL entry points, then reports that there
+    // is no X display; that is expected here
+    GLenum err = glewInit();
+    if (err != GLEW_OK && err != GLEW_ERROR_NO_GLX_DISPLAY) { std::cerr << "Headless: glewInit failed" << std::endl; return false; }
+    std::cout << "Headless renderer: " << glGetString(GL_RENDERER) << " (" << width << "x" << height << ")" << std::endl;
+
+    headlessW_ = width; headlessH_ = height;
+    glGenTextures(1, &headlessColor_);
+    glBindTexture(GL_TEXTURE_2D, headlessColor_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glGenRenderbuffers(1, &headlessDepth_);
+    glBindRenderbuffer(GL_RENDERBUFFER, headlessDepth_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glGenFramebuffers(1, &headlessFbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, headlessFbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, headlessColor_, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headlessDepth_);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) { std::cerr << "Headless: incomplete framebuffer" << std::endl; return false; }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return initResources();
+}
+
+// GL state, programs, terrain and everything else that only needs a current context
+bool Engine::initResources() {
     // GL settings
-    glEnable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
+    gl_.invalidate();
+    gl_.enable(GL_DEPTH_TEST);
+    gl_.disable(GL_CULL_FACE);
 
     // Resources Loading(shaders, terrain mesh, etc)
     shaderProgram_ = createProgram("Nut/shaders/vertex.glsl", "Nut/shaders/fragment.glsl");
 
+    depthProgram_ = createProgram("Nut/shaders/depth_vert.glsl", "Nut/shaders/depth_frag.glsl");
+
     // Create sky shader and full-screen triangle VAO
     skyShader_ = createProgram("Nut/shaders/sky_vert.glsl", "Nut/shaders/sky_frag.glsl");
     {
@@ -122,26 +238,31 @@ bool Engine::init(bool fullscreen) {
         // Setup sky VAO/VBO
         glGenVertexArrays(1, &skyVAO_);
         glGenBuffers(1, &skyVBO_);
-        glBindVertexArray(skyVAO_);
+        gl_.bindVertexArray(skyVAO_);
         glBindBuffer(GL_ARRAY_BUFFER, skyVBO_);
         glBufferData(GL_ARRAY_BUFFER, sizeof(skyVerts), skyVerts, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-        glBindVertexArray(0);
+        gl_.bindVertexArray(0);
     }
 
+    // GPU height generator (optional backend, reuses the full-screen triangle)
+    heightGenShader_ = createProgram("Nut/shaders/fullscreen_vert.glsl", "Nut/shaders/heightgen_frag.glsl");
+    // Dynamic resolution: scaled scene -> backbuffer
+    upscaleProgram_ = createProgram("Nut/shaders/fullscreen_vert.glsl", "Nut/shaders/upscale_frag.glsl");
+    setupPrograms();
+    for (SceneQueries &q : sceneQueries_) { glGenQueries(SceneQueries::Count, q.ids); q.pending = false; }
+    graph_.setPassHooks([this](const char* pass) { PROFILE_BEGIN(pass); gpuTimer_.begin(pass); },
+                        [this](const char*) { gpuTimer_.end(); PROFILE_END(); });
+
     buildTerrainMesh(); // helper builds terrain and calls
     uploadMeshToGPU();  // helper uploads mesh to GPU
 
-    // Initialize GUI after the OpenGL context is created
-    // if (gui_) gui_->init(window_);
-
     return true;
 }
 
 void Engine::vsync(bool enabled) {
-    vsyncEnabled_ = enabled;
-    if (window_) glfwSwapInterval(enabled ? 1 : 0);
+    vsyncEnabled_ = enabled;   // applied by whichever thread swaps, see drawWindowFrame
 }
 
 void Engine::load_terrain_using_texture(const std::string &path) {
@@ -153,107 +274,293 @@ void Engine::mainloop() {
     // Safety check
     if (!window_) return;
 
-    // Set some uniforms that don't change often (terrain shader)
-    glUseProgram(shaderProgram_);
-    glUniform3f(glGetUniformLocation(shaderProgram_, "lightDir"), -0.2f, -1.0f, -0.3f);
-    glUniform3f(glGetUniformLocation(shaderProgram_, "lightColor"), 1.0f, 0.98f, 0.9f);
-    glUniform1i(glGetUniformLocation(shaderProgram_, "texture1"), 0);
-    glUniform3f(glGetUniformLocation(shaderProgram_, "fogColor"), 0.53f, 0.8f, 1.0f);
-    glUniform1f(glGetUniformLocation(shaderProgram_, "fogDensity"), 0.008f);
+    // Optional per-frame timing log
+    FILE* timingLog = openTimingLog();
+    uint64_t frameIndex = 0;
+
+    // Movement runs on the simulation thread; drawing on the render thread
+    // unless disabled (or a GUI needs its input on this thread)
+    PROFILE_THREAD("main");
+    const bool threaded = renderThreadEnabled_ && !gui_;
+    inputLatencyMs_.clear(); inputLatencyCount_ = 0;
+    inputShown_ = lastInputTime_;
+    startSimulation();
+    lastFrame_ = Clock::now();
+    const Clock::time_point startTime = lastFrame_;
+    publishPacket();
+    if (threaded) {
+        // The context moves to the render thread; this thread only sleeps
+        // in glfwWaitEvents, forwarding input and window state as it comes
+        glfwMakeContextCurrent(nullptr);
+        renderRunning_.store(true);
+        renderThread_ = std::thread(&Engine::renderLoop, this, timingLog, startTime);
+        while (!glfwWindowShouldClose(window_)) {
+            {
+                PROFILE_ZONE("wait events");
+                glfwWaitEvents();
+            }
+            publishPacket();
+            if (replayDone_.load()) glfwSetWindowShouldClose(window_, true);
+        }
+        renderRunning_.store(false);
+        renderThread_.join();
+        glfwMakeContextCurrent(window_);   // teardown still needs GL here
+    } else {
+        while (!glfwWindowShouldClose(window_)) {
+            drawWindowFrame(frameIndex++, startTime, timingLog);
+            {
+                PROFILE_ZONE("poll events");
+                glfwPollEvents();
+            }
+            publishPacket();
+            if (replayDone_.load()) glfwSetWindowShouldClose(window_, true);
+        }
+    }
+    stopSimulation();
+    if (timingLog) std::fclose(timingLog);
 
-    // sky shader texture unit binding (panorama will be bound to unit 1 at render time)
-    glUseProgram(skyShader_);
-    glUniform1i(glGetUniformLocation(skyShader_, "panorama"), 1);
-    // set initial cloud uniforms (time will be updated per-frame)
-    glUniform1i(glGetUniformLocation(skyShader_, "cloudEnabled"), cloudEnabled_ ? 1 : 0);
-    glUniform1f(glGetUniformLocation(skyShader_, "cloudSpeed"), cloudSpeed_);
-    glUniform1f(glGetUniformLocation(skyShader_, "cloudScale"), cloudScale_);
-    glUniform1f(glGetUniformLocation(skyShader_, "cloudOpacity"), cloudOpacity_);
+    BenchReport::Summary s = BenchReport::summarize(inputLatencyMs_);
+    std::printf("mainloop (%s): input latency over the last %zu inputs: mean %.2f ms, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f ms\n",
+                threaded ? "render thread" : "single thread", s.samples, s.mean, s.p50, s.p95, s.p99, s.max);
+    if (!tracePath_.empty()) writeTrace();
+}
+
+// Main thread (owns GLFW): hand the current window state to the drawing thread
+void Engine::publishPacket() {
+    RenderPacket &p = packets_.back();
+    glfwGetFramebufferSize(window_, &p.fbWidth, &p.fbHeight);
+    p.seq = ++packetSeq_;
+    packets_.publish();
+}
 
-    // Get initial window size
-    int SCR_W, SCR_H;
-    glfwGetWindowSize(window_, &SCR_W, &SCR_H);
+// Render thread body: owns the GL context until mainloop stops it
+void Engine::renderLoop(FILE* timingLog, Clock::time_point startTime) {
+    PROFILE_THREAD("render");
+    glfwMakeContextCurrent(window_);
+    for (uint64_t frameIndex = 0; renderRunning_.load(std::memory_order_acquire); ++frameIndex)
+        drawWindowFrame(frameIndex, startTime, timingLog);
+    glFinish();
+    glfwMakeContextCurrent(nullptr);
+}
+
+// One interactive frame on the thread holding the context: latest window
+// state and sim frame, draw, swap, then the input latency sample
+void Engine::drawWindowFrame(uint64_t frameIndex, Clock::time_point startTime, FILE* timingLog) {
+    PROFILE_ZONE("frame");
+    // Timing
+    gl_.beginFrame();
+    auto now = Clock::now();
+    deltaTime_ = std::chrono::duration<float>(now - lastFrame_).count();
+    lastFrame_ = now;
+
+    // Window state from the main thread; vsync changes land here, where the
+    // context is current
+    packets_.update();
+    const RenderPacket &packet = packets_.front();
+    int interval = vsyncEnabled_.load(std::memory_order_relaxed) ? 1 : 0;
+    if (interval != swapInterval_) { glfwSwapInterval(interval); swapInterval_ = interval; }
+
+    // Latest sim frame, interpolated to the present
+    simFrames_.update(); frame_ = simFrames_.front();
+    float alpha = glm::clamp(std::chrono::duration<float>(now - frame_.tickTime).count() / frame_.step, 0.0f, 1.0f);
+    glm::vec3 eye = glm::mix(frame_.prevPos, frame_.pos, alpha);
+
+    // Draw into the window at its framebuffer size
+    renderFrame(eye, frame_.yaw, frame_.pitch, std::chrono::duration<double>(now - startTime).count(), packet.fbWidth, packet.fbHeight, 0, frameIndex);
+    {
+        PROFILE_ZONE("swap");
+        glfwSwapBuffers(window_);
+    }
 
-    // Main loop
+    // Input latency: the newest input this frame's sim state includes has
+    // been on screen since the swap returned
+    float inputMs = -1.0f;
+    if (frame_.inputTime > inputShown_) {
+        inputMs = std::chrono::duration<float, std::milli>(Clock::now() - frame_.inputTime).count();
+        inputShown_ = frame_.inputTime;
+        if (inputLatencyMs_.size() < LATENCY_WINDOW) inputLatencyMs_.push_back(inputMs);
+        else inputLatencyMs_[inputLatencyCount_ % LATENCY_WINDOW] = inputMs;
+        ++inputLatencyCount_;
+    }
+
+    if (timingLog) {
+        std::fprintf(timingLog, "%llu,%llu,%.3f,%.9g,%.9g,%.9g,%.3f,", (unsigned long long)frameIndex, (unsigned long long)frame_.tick,
+                     deltaTime_ * 1000.0f, frame_.pos.x, frame_.pos.y, frame_.pos.z, gpuTimer_.frameMs());
+        if (inputMs >= 0.0f) std::fprintf(timingLog, "%.3f", inputMs);
+        std::fputc('\n', timingLog);
+    }
+}
+
+// Scripted run: frames evenly spread over path on a fixed 60 Hz animation
+// clock, no simulation thread. In a window vsync is off for the run; headless
+// keeps at most two frames in flight (fences stand in for the swap chain).
+// Frame times go to the timing log, a summary to stdout, and frame / CPU
+// zone / GPU pass samples to the bench report.
+bool Engine::runFlythrough(const CameraPath &path, int frames) {
+    if ((!window_ && !headless_.valid()) || path.empty() || frames <= 0) return false;
+    FILE* timingLog = openTimingLog();
+    PROFILE_THREAD("main");
+    if (window_) { glfwSwapInterval(0); swapInterval_ = 0; }
+
+    int width = headlessW_, height = headlessH_;
+    BenchReport report;
+    std::vector<float> frameMs;
+    frameMs.reserve(frames);
+    std::vector<uint64_t> gpuResults;
+    std::vector<std::vector<float>> gpuMs;
+    GLsync inFlight[2] = {nullptr, nullptr};
+    const uint64_t startTick = Profiler::ticks();
     lastFrame_ = Clock::now();
-    while (!glfwWindowShouldClose(window_)) {
-        // Timing
+    int i = 0;
+    for (; i < frames; ++i) {
+        PROFILE_ZONE("frame");
+        gl_.beginFrame();
+        if (window_) glfwGetFramebufferSize(window_, &width, &height);
+        CameraKey cam = path.sample(frames > 1 ? (float)i / (frames - 1) : 0.0f);
+        renderFrame(cam.pos, cam.yaw, cam.pitch, i / 60.0, width, height, headlessFbo_, (uint64_t)i);
+
+        {
+            PROFILE_ZONE("present");
+            if (window_) {
+                glfwSwapBuffers(window_);
+                glfwPollEvents();
+            } else {
+                // Wait for the frame before last, as a double-buffered swap would
+                GLsync &slot = inFlight[i & 1];
+                if (slot) { glClientWaitSync(slot, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED); glDeleteSync(slot); }
+                slot = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                glFlush();
+            }
+        }
+
         auto now = Clock::now();
         deltaTime_ = std::chrono::duration<float>(now - lastFrame_).count();
         lastFrame_ = now;
-        updateMovement(deltaTime_);
-
-        // Camera
-        glm::vec3 front(
-            cos(glm::radians(yaw_)) * cos(glm::radians(pitch_)),
-            sin(glm::radians(pitch_)),
-            sin(glm::radians(yaw_)) * cos(glm::radians(pitch_))
-        );
-
-        // View and Projection matrices
-        glm::mat4 view = glm::lookAt(cameraPos_, cameraPos_ + glm::normalize(front), glm::vec3(0,1,0));
-        glm::mat4 proj = glm::perspective(glm::radians(60.0f), (float)SCR_W / (float)SCR_H, 0.1f, 500.0f);
-        glm::mat4 model(1.0f);
-
-        // --- Clear first (important!) ---
-        glClearColor(0.53f, 0.8f, 1.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // --- Draw sky full-screen triangle ---
-        glDisable(GL_DEPTH_TEST);
-
-        // Inverse matrices
-        glm::mat4 invProj = glm::inverse(proj);
-
-        // Draw sky
-        glUseProgram(skyShader_);
-        glUniformMatrix4fv(glGetUniformLocation(skyShader_, "invProj"), 1, GL_FALSE, glm::value_ptr(invProj));
-
-    // Provide full inverse view matrix; the vertex shader uses mat3(invView) so
-    // translation is ignored and the sky remains fixed (no parallax from camera position).
-    glm::mat4 invView = glm::inverse(view);
-    glUniformMatrix4fv(glGetUniformLocation(skyShader_, "invView"), 1, GL_FALSE, glm::value_ptr(invView));
-    glUniform1i(glGetUniformLocation(skyShader_, "hasPanorama"), panoramaTexture_ ? 1 : 0);
-    // update animated uniforms
-    float t = (float)std::chrono::duration<double>(Clock::now() - lastFrame_).count();
-    // Use running time since program start for smoother animation
-    static double startTime = std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
-    float runTime = (float)(std::chrono::duration<double>(Clock::now().time_since_epoch()).count() - startTime);
-    glUniform1f(glGetUniformLocation(skyShader_, "time"), runTime);
-    glUniform1i(glGetUniformLocation(skyShader_, "cloudEnabled"), cloudEnabled_ ? 1 : 0);
-    glUniform1f(glGetUniformLocation(skyShader_, "cloudSpeed"), cloudSpeed_);
-    glUniform1f(glGetUniformLocation(skyShader_, "cloudScale"), cloudScale_);
-    glUniform1f(glGetUniformLocation(skyShader_, "cloudOpacity"), cloudOpacity_);
-
-        // Bind panorama texture if available
-        if (panoramaTexture_) {
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, panoramaTexture_);
+        frameMs.push_back(deltaTime_ * 1000.0f);
+        if (timingLog) std::fprintf(timingLog, "%d,%d,%.3f,%.9g,%.9g,%.9g,%.3f,\n", i, i, deltaTime_ * 1000.0f, cam.pos.x, cam.pos.y, cam.pos.z, gpuTimer_.frameMs());
+
+        // Every GPU result that landed this frame (results trail by FRAMES)
+        std::vector<GpuPassTimer::Stats> gpu = gpuTimer_.stats();
+        gpuResults.resize(gpu.size(), 0);
+        gpuMs.resize(gpu.size());
+        for (size_t p = 0; p < gpu.size(); ++p) {
+            if (gpu[p].results != gpuResults[p]) gpuMs[p].push_back(gpu[p].lastMs);
+            gpuResults[p] = gpu[p].results;
         }
+        if (window_ && glfwWindowShouldClose(window_)) { ++i; break; }
+    }
+    for (GLsync s : inFlight) if (s) { glClientWaitSync(s, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED); glDeleteSync(s); }
+    if (timingLog) std::fclose(timingLog);
+    if (window_) { swapInterval_ = vsyncEnabled_ ? 1 : 0; glfwSwapInterval(swapInterval_); }
+
+    report.setInfo("renderer", (const char*)glGetString(GL_RENDERER));
+    report.setInfo("mode", window_ ? "window" : "headless");
+    report.setInfo("build_flags", NUT_BUILD_FLAGS);
+    report.setInfo("resolution", std::to_string(width) + "x" + std::to_string(height));
+    report.setInfo("frames", std::to_string(i));
+    char terrain[96];
+    std::snprintf(terrain, sizeof(terrain), "%d verts, scale %g, height %g", terrainSize_.load(), terrainScale_.load(), heightScale_.load());
+    report.setInfo("terrain", terrain);
+    char dynRes[64] = "off";
+    if (dynamicRes_) std::snprintf(dynRes, sizeof(dynRes), "budget %g ms, final scale %.2f", dynRes_.targetMs(), dynRes_.scale());
+    report.setInfo("dynamic_resolution", dynRes);
+    report.add("frame", "frame_ms", frameMs);
+    for (const Profiler::ZoneTimes &z : Profiler::zoneTimes(startTick)) report.add("cpu", z.name, z.ms);
+    std::vector<GpuPassTimer::Stats> gpu = gpuTimer_.stats();
+    for (size_t p = 0; p < gpuMs.size(); ++p) report.add("gpu", gpu[p].name, gpuMs[p]);
+
+    BenchReport::Summary s = BenchReport::summarize(frameMs);
+    std::printf("flythrough: %d frames at %dx%d, mean %.2f ms, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f ms\n", i, width, height,
+                s.mean, s.p50, s.p95, s.p99, s.max);
+    if (!tracePath_.empty()) writeTrace();
+    if (!benchReportPath_.empty() && report.write(benchReportPath_)) std::cout << "Wrote bench report " << benchReportPath_ << std::endl;
+    return benchBaselinePath_.empty() || report.compare(benchBaselinePath_, benchThresholdPct_);
+}
 
-        // Draw full-screen triangle
-        glBindVertexArray(skyVAO_);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-        glBindVertexArray(0);
+void Engine::setBenchReport(const std::string &path) { benchReportPath_ = path; }
+void Engine::setBenchBaseline(const std::string &path, double thresholdPct) { benchBaselinePath_ = path; benchThresholdPct_ = thresholdPct; }
+
+// Timing log named by setFrameTimingLog (nullptr when unset)
+FILE* Engine::openTimingLog() const {
+    FILE* f = timingLogPath_.empty() ? nullptr : std::fopen(timingLogPath_.c_str(), "w");
+    if (f) std::fprintf(f, "frame,tick,frame_ms,x,y,z,gpu_ms,input_ms\n");
+    return f;
+}
 
-        // --- Re-enable depth test for terrain ---
-        glEnable(GL_DEPTH_TEST);
+// Closed loop over the middle of the terrain, 20 units above the ground,
+// looking along the loop and slightly down
+CameraPath Engine::defaultFlightPath() {
+    CameraPath path;
+    float radius = (terrainSize_ - 1) * terrainScale_ * 0.3f;
+    const int KEYS = 16;
+    for (int i = 0; i < KEYS; ++i) {
+        float a = 6.2831853f * i / KEYS;
+        float x = radius * std::cos(a), z = radius * std::sin(a);
+        path.add(CameraKey{glm::vec3(x, getTerrainHeight(x, z) + 20.0f, z), glm::degrees(a) + 90.0f, -12.0f});
+    }
+    path.setClosed(true);
+    return path;
+}
 
-        // --- Then draw terrain ---
-        glUseProgram(shaderProgram_);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram_, "mvp"), 1, GL_FALSE, glm::value_ptr(proj * view * model));
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram_, "model"), 1, GL_FALSE, glm::value_ptr(model));
-        glUniform3fv(glGetUniformLocation(shaderProgram_, "viewPos"), 1, glm::value_ptr(cameraPos_));
+// One frame of the scene from the given camera into framebuffer target
+// (0: the window), width x height; time drives the sky animation
+void Engine::renderFrame(const glm::vec3 &eye, float yaw, float pitch, double time, int width, int height, GLuint target, uint64_t frameIndex) {
+    if (width <= 0 || height <= 0) return;   // minimised
+
+    // Pick up GPU-generated heights once their readback has landed
+    pollGpuHeights(false);
+
+    // Page in a new DEM window once the camera strays from the current one;
+    // it is built on JobPool and swapped in here a few frames later
+    pollDemWindow();
+    if (dem_ && demNeedsRecenter()) dispatchDemWindow();
+
+    // Camera
+    glm::vec3 front(
+        cos(glm::radians(yaw)) * cos(glm::radians(pitch)),
+        sin(glm::radians(pitch)),
+        sin(glm::radians(yaw)) * cos(glm::radians(pitch))
+    );
+
+    // View and Projection matrices
+    glm::mat4 view = glm::lookAt(eye, eye + glm::normalize(front), glm::vec3(0,1,0));
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), (float)width / (float)height, 0.1f, 500.0f);
+    glm::mat4 model(1.0f);
+    {
+        std::lock_guard<std::mutex> lock(cameraMutex_);
+        lastViewProj_ = proj * view; lastEye_ = eye;
+    }
 
-        // Bind grass texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, grassTexture_);
-        glBindVertexArray(vao_);
-        glDrawElements(GL_TRIANGLES, (GLsizei)indexCount_, GL_UNSIGNED_INT, 0);
+    // Per-frame block shared by the sky and terrain programs
+    FrameUniforms fu;
+    fu.view = view; fu.proj = proj; fu.viewProj = proj * view;
+    fu.invView = glm::inverse(view); fu.invProj = glm::inverse(proj);
+    fu.model = model; fu.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(model))));
+    fu.viewPos = eye;
+    fu.time = (float)time;
+    frameUbo_.update(fu);
+
+    // Counters of the frame that last used this query set (never stalls)
+    SceneQueries &q = sceneQueries_[frameIndex & 1];
+    readSceneQueries(q);
+
+    // Scene resolution from the latest completed GPU frame; upscale and GUI
+    // run at native resolution whatever the scale
+    if (dynamicRes_) {
+        float sceneMs = gpuTimer_.passMs("sky") + gpuTimer_.passMs("depth_prepass") + gpuTimer_.passMs("terrain");
+        dynRes_.update(sceneMs, gpuTimer_.frameMs() - sceneMs);
+    }
+    float scale = dynamicRes_ ? dynRes_.scale() : 1.0f;
+    sceneW_ = std::max(1, (int)std::lround(width * scale));
+    sceneH_ = std::max(1, (int)std::lround(height * scale));
 
-        // Swap buffers and poll events
-        glfwSwapBuffers(window_);
-        glfwPollEvents();
+    // Declare, compile and run this frame's passes
+    {
+        PROFILE_ZONE("render graph");
+        declarePasses(width, height, target, q);
+        gpuTimer_.beginFrame();
+        if (graph_.compile()) graph_.execute(gl_);
+        q.pending = true;
     }
 }
 
@@ -318,108 +625,551 @@ GLuint Engine::createProgram(const char* vsPath, const char* fsPath) {
     glDeleteShader(vs); glDeleteShader(fs); return prog;
 }
 
-// ---------------- Terrain generation inline helpers ----------------
-inline float lerp(float a, float b, float t) { return a + (b - a) * t; } // linear interpolation
-inline float fade(float t) { return t * t * (3.0f - 2.0f * t); }         // fade function for smoothstep
+// Scene passes for one frame. Without dynamic resolution the scene draws
+// straight into the backbuffer; with it, it draws into sceneW_ x sceneH_
+// transients that the upscale pass stretches over the backbuffer (also at
+// scale 1, so the controller has measured the upscale before its first
+// drop). The graph
+// clears the scene targets (sky colour, depth 1) on their first write and
+// orders the passes by their colour / depth writes. The GUI comes last, at
+// native resolution.
+void Engine::declarePasses(int width, int height, GLuint target, SceneQueries &q) {
+    typedef RenderGraph::Builder Builder;
+    typedef RenderGraph::Context Context;
+    typedef RenderGraph::Resource Resource;
+    const float skyColor[4] = {0.53f, 0.8f, 1.0f, 1.0f};
+    graph_.beginFrame(width, height, skyColor, target);
+
+    // Scene targets, created by whichever scene pass is declared first
+    const bool scaled = dynamicRes_ || sceneW_ != width || sceneH_ != height;
+    Resource color = RenderGraph::BACKBUFFER, depth = RenderGraph::BACKBUFFER_DEPTH;
+    bool created = !scaled;
+    auto scene = [&](Builder &b) {
+        if (created) return;
+        RGTextureDesc c;
+        c.format = GL_RGBA8; c.width = sceneW_; c.height = sceneH_; c.clear = true;
+        std::copy(skyColor, skyColor + 4, c.clearColor);
+        RGTextureDesc d = c;
+        d.format = GL_DEPTH_COMPONENT24;
+        color = b.create("scene_color", c);
+        depth = b.create("scene_depth", d);
+        created = true;
+    };
+
+    // Sky first: full-screen fill without depth test (kept for comparison)
+    if (!skyLast_)
+        graph_.addPass("sky", [&](Builder &b) { scene(b); b.write(color); },
+            [this, &q](const Context&) {
+                gl_.disable(GL_DEPTH_TEST);
+                glBeginQuery(GL_SAMPLES_PASSED, q.ids[SceneQueries::Sky]);
+                drawSky();
+                glEndQuery(GL_SAMPLES_PASSED);
+            });
+
+    // Optional position-only depth prepass
+    if (depthPrepass_)
+        graph_.addPass("depth_prepass", [&](Builder &b) { scene(b); b.write(depth); },
+            [this](const Context&) {
+                gl_.enable(GL_DEPTH_TEST); gl_.depthFunc(GL_LESS); gl_.depthMask(true); gl_.colorMask(false);
+                drawTerrain(true);
+                gl_.colorMask(true);
+            });
+
+    graph_.addPass("terrain", [&](Builder &b) { scene(b); b.write(color); b.write(depth); },
+        [this, &q](const Context&) {
+            gl_.enable(GL_DEPTH_TEST);
+            gl_.depthFunc(depthPrepass_ ? GL_LEQUAL : GL_LESS);
+            gl_.depthMask(!depthPrepass_);
+            glBeginQuery(GL_SAMPLES_PASSED, q.ids[SceneQueries::Terrain]);
+            drawTerrain(false);
+            glEndQuery(GL_SAMPLES_PASSED);
+        });
+
+    // Sky last: on the far plane with GL_LEQUAL, so early-Z rejects every
+    // pixel the terrain covered and the cloud fbm runs only where visible
+    if (skyLast_)
+        graph_.addPass("sky", [&](Builder &b) { b.write(color); b.write(depth); },
+            [this, &q](const Context&) {
+                gl_.enable(GL_DEPTH_TEST); gl_.depthFunc(GL_LEQUAL); gl_.depthMask(false);
+                glBeginQuery(GL_SAMPLES_PASSED, q.ids[SceneQueries::Sky]);
+                drawSky();
+                glEndQuery(GL_SAMPLES_PASSED);
+            });
+
+    // Bilinear stretch of the scaled scene over the backbuffer
+    if (scaled)
+        graph_.addPass("upscale", [&](Builder &b) { b.read(color); b.write(RenderGraph::BACKBUFFER); },
+            [this, color](const Context &ctx) {
+                gl_.disable(GL_DEPTH_TEST);
+                gl_.useProgram(upscaleProgram_);
+                glUniform2f(upscaleInvSizeLoc_, 1.0f / ctx.width, 1.0f / ctx.height);
+                gl_.bindTexture(0, GL_TEXTURE_2D, ctx.texture(color));
+                gl_.bindVertexArray(skyVAO_);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            });
+
+    // GUI over the final image at native resolution; ImGui's backend sets GL
+    // state behind the cache
+    if (gui_)
+        graph_.addPass("gui", [](Builder &b) { b.write(RenderGraph::BACKBUFFER); b.sideEffect(); },
+            [this](const Context&) { gui_->render(); gl_.invalidate(); });
+}
+
+// Full-screen sky triangle; the caller sets depth state
+void Engine::drawSky() {
+    gl_.useProgram(skyShader_);
+    SkyParams sky = {panoramaTexture_ ? 1 : 0, cloudEnabled_ ? 1 : 0, cloudSpeed_, cloudScale_, cloudOpacity_};
+    if (!skySentValid_ || std::memcmp(&sky, &skySent_, sizeof(sky)) != 0) {
+        glUniform1i(skyLoc_.hasPanorama, sky.hasPanorama);
+        glUniform1i(skyLoc_.cloudEnabled, sky.cloudEnabled);
+        glUniform1f(skyLoc_.cloudSpeed, sky.speed);
+        glUniform1f(skyLoc_.cloudScale, sky.scale);
+        glUniform1f(skyLoc_.cloudOpacity, sky.opacity);
+        skySent_ = sky; skySentValid_ = true;
+    }
+    if (panoramaTexture_) gl_.bindTexture(1, GL_TEXTURE_2D, panoramaTexture_);
+    gl_.bindVertexArray(skyVAO_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
 
-int hashI(int x, int y) { int n = x + y * 57; n = (n << 13) ^ n; return (n * (n * n * 60493 + 19990303) + 1376312589) & 0x7fffffff; } // integer hash
+Engine::TerrainParams Engine::terrainParams() const {
+    TerrainParams tp = {0, 0, 0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    if (terrainRenderMode_ == TerrainRenderMode::HeightTexture && heightTex_) {
+        float half = (terrainSize_ - 1) * 0.5f * terrainScale_;
+        tp = {1, heightTexSize_, PATCH_QUADS, (heightTexSize_ - 1 + PATCH_QUADS - 1) / PATCH_QUADS,
+              gridOriginX_, gridOriginZ_, gridSpacing_, half, textureTile_ / (2.0f * half)};
+    }
+    return tp;
+}
 
-float valueNoise(int x, int y) { return (hashI(x, y) / float(0x7fffffff)) * 2.0f - 1.0f; } // value noise in [-1,1]
+void Engine::sendTerrainParams(const TerrainUniforms &loc, const TerrainParams &tp, TerrainParams &sent, bool &valid) {
+    if (valid && std::memcmp(&tp, &sent, sizeof(tp)) == 0) return;
+    glUniform1i(loc.heightMode, tp.heightMode);
+    glUniform1i(loc.gridN, tp.gridN);
+    glUniform1i(loc.patchQuads, tp.patchQuads);
+    glUniform1i(loc.patchesPerSide, tp.patchesPerSide);
+    glUniform2f(loc.gridOrigin, tp.originX, tp.originZ);
+    glUniform1f(loc.gridSpacing, tp.spacing);
+    glUniform2f(loc.uvParams, tp.uvHalf, tp.uvScale);
+    sent = tp; valid = true;
+}
 
-// 2D smooth noise
-float smoothNoise(float x, float y) {
-    int xf = (int)floor(x); int yf = (int)floor(y);
-    float xf_frac = x - xf; float yf_frac = y - yf;
-    float v00 = valueNoise(xf, yf); float v10 = valueNoise(xf + 1, yf); float v01 = valueNoise(xf, yf + 1); float v11 = valueNoise(xf + 1, yf + 1);
-    float i1 = lerp(v00, v10, fade(xf_frac)); float i2 = lerp(v01, v11, fade(xf_frac)); return lerp(i1, i2, fade(yf_frac));
+// Terrain mesh or instanced height-texture patches, shaded or (depthOnly)
+// through the position-only prepass program; the caller sets depth state
+void Engine::drawTerrain(bool depthOnly) {
+    TerrainParams tp = terrainParams();
+    if (depthOnly) {
+        gl_.useProgram(depthProgram_);
+        sendTerrainParams(depthLoc_, tp, depthSent_, depthSentValid_);
+    } else {
+        gl_.useProgram(shaderProgram_);
+        sendTerrainParams(terrainLoc_, tp, terrainSent_, terrainSentValid_);
+        gl_.bindTexture(0, GL_TEXTURE_2D, grassTexture_);
+    }
+    if (tp.heightMode) {
+        // Instanced grid patches displaced from the height texture (unit 2)
+        gl_.bindTexture(2, GL_TEXTURE_2D, heightTex_);
+        gl_.bindVertexArray(patchVAO_);
+        glDrawElementsInstanced(GL_TRIANGLES, patchIndexCount_, GL_UNSIGNED_INT, 0, tp.patchesPerSide * tp.patchesPerSide);
+    } else {
+        gl_.bindVertexArray(vao_);
+        glDrawElements(GL_TRIANGLES, (GLsizei)indexCount_, GL_UNSIGNED_INT, 0);
+    }
 }
 
-float Engine::fbm(float x, float y) {
-    float total = 0.0f; float amp = 1.0f; float freq = 1.0f; const int OCT = 6; const float gain = 0.5f;
-    for (int i = 0; i < OCT; ++i) { total += amp * smoothNoise(x * freq, y * freq); freq *= 2.0f; amp *= gain; }
-    return total;
+// Pick up a query set's results once the GPU has them; a set still in
+// flight keeps the previous numbers rather than waiting
+void Engine::readSceneQueries(SceneQueries &q) {
+    if (!q.pending) return;
+    GLuint ready = 0;
+    for (GLuint id : q.ids) {
+        glGetQueryObjectuiv(id, GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready) return;
+    }
+    GLuint64 sky = 0, terrain = 0;
+    glGetQueryObjectui64v(q.ids[SceneQueries::Sky], GL_QUERY_RESULT, &sky);
+    glGetQueryObjectui64v(q.ids[SceneQueries::Terrain], GL_QUERY_RESULT, &terrain);
+    skyFragments_ = sky; terrainFragments_ = terrain;
+    q.pending = false;
 }
 
+// Resolve uniform locations once, route the Frame block of every program to
+// the shared UBO and set the uniforms that never change
+void Engine::setupPrograms() {
+    frameUbo_.create();
+    FrameUniformBuffer::attach(shaderProgram_);
+    FrameUniformBuffer::attach(skyShader_);
+    FrameUniformBuffer::attach(depthProgram_);
+
+    terrainLoc_.heightMode = glGetUniformLocation(shaderProgram_, "heightMode");
+    terrainLoc_.gridN = glGetUniformLocation(shaderProgram_, "gridN");
+    terrainLoc_.patchQuads = glGetUniformLocation(shaderProgram_, "patchQuads");
+    terrainLoc_.patchesPerSide = glGetUniformLocation(shaderProgram_, "patchesPerSide");
+    terrainLoc_.gridOrigin = glGetUniformLocation(shaderProgram_, "gridOrigin");
+    terrainLoc_.gridSpacing = glGetUniformLocation(shaderProgram_, "gridSpacing");
+    terrainLoc_.uvParams = glGetUniformLocation(shaderProgram_, "uvParams");
+    depthLoc_.heightMode = glGetUniformLocation(depthProgram_, "heightMode");
+    depthLoc_.gridN = glGetUniformLocation(depthProgram_, "gridN");
+    depthLoc_.patchQuads = glGetUniformLocation(depthProgram_, "patchQuads");
+    depthLoc_.patchesPerSide = glGetUniformLocation(depthProgram_, "patchesPerSide");
+    depthLoc_.gridOrigin = glGetUniformLocation(depthProgram_, "gridOrigin");
+    depthLoc_.gridSpacing = glGetUniformLocation(depthProgram_, "gridSpacing");
+    depthLoc_.uvParams = -1;
+    skyLoc_.hasPanorama = glGetUniformLocation(skyShader_, "hasPanorama");
+    skyLoc_.cloudEnabled = glGetUniformLocation(skyShader_, "cloudEnabled");
+    skyLoc_.cloudSpeed = glGetUniformLocation(skyShader_, "cloudSpeed");
+    skyLoc_.cloudScale = glGetUniformLocation(skyShader_, "cloudScale");
+    skyLoc_.cloudOpacity = glGetUniformLocation(skyShader_, "cloudOpacity");
+    terrainSentValid_ = skySentValid_ = depthSentValid_ = false;
+
+    // Terrain shader constants
+    gl_.useProgram(shaderProgram_);
+    glUniform3f(glGetUniformLocation(shaderProgram_, "lightDir"), -0.2f, -1.0f, -0.3f);
+    glUniform3f(glGetUniformLocation(shaderProgram_, "lightColor"), 1.0f, 0.98f, 0.9f);
+    glUniform1i(glGetUniformLocation(shaderProgram_, "texture1"), 0);
+    glUniform1i(glGetUniformLocation(shaderProgram_, "heightTex"), 2);
+    gl_.useProgram(depthProgram_);
+    glUniform1i(glGetUniformLocation(depthProgram_, "heightTex"), 2);
+
+    // Sky: panorama is bound to unit 1 at render time
+    gl_.useProgram(skyShader_);
+    glUniform1i(glGetUniformLocation(skyShader_, "panorama"), 1);
+
+    // Upscale: scene colour on unit 0
+    gl_.useProgram(upscaleProgram_);
+    glUniform1i(glGetUniformLocation(upscaleProgram_, "sceneColor"), 0);
+    upscaleInvSizeLoc_ = glGetUniformLocation(upscaleProgram_, "invTargetSize");
+}
+
+// ---------------- Terrain generation ----------------
+float Engine::fbm(float x, float y) { return fbmNoise(x, y); } // shared with tools, see terrain/noise.h
+
 float Engine::getTerrainHeight(float wx, float wz) {
+    // Over the drawn terrain: O(1) lookup in the published grid, interpolated
+    // with the mesh's own triangle split so the camera sits exactly on the surface
+    std::shared_ptr<const TerrainGrid> grid = heightQuery_.snapshot();
+    if (grid && grid->contains(wx, wz)) return grid->height(wx, wz);
+
+    // Outside it, fall back to the height source itself (runs on the sim
+    // thread: the settings are read once, atomically)
+    const float scale = terrainScale_.load(std::memory_order_relaxed), heightScale = heightScale_.load(std::memory_order_relaxed);
+    // DEM: bilinear sample of the full-resolution data (world origin = DEM center)
+    std::lock_guard<std::mutex> lock(demMutex_);
+    if (dem_) return dem_->sample(wx / scale + (dem_->width() - 1) * 0.5, wz / scale + (dem_->height() - 1) * 0.5) * heightScale;
+
     // Convert world coords to terrain local coords using runtime-configurable values
-    float half = (terrainSize_ - 1) * 0.5f * terrainScale_;
-    float x = (wx + half) / terrainScale_;
-    float z = (wz + half) / terrainScale_;
-    return fbm(x * 0.06f, z * 0.06f) * heightScale_;
+    float half = (terrainSize_.load(std::memory_order_relaxed) - 1) * 0.5f * scale;
+    float x = (wx + half) / scale;
+    float z = (wz + half) / scale;
+    return fbm(x * 0.06f, z * 0.06f) * heightScale;
 }
 
 void Engine::buildTerrainMesh() {
-    // Build terrain mesh (vertices, normals, uvs, indices)
-    std::vector<Vertex> vertices; std::vector<GLuint> indices;
-
+    PROFILE_FUNCTION();
+    ++terrainGeneration_;   // a re-centre still in flight is now stale
     // number of vertices along one side (runtime-configurable)
     int N = terrainSize_; float half = (N - 1) * 0.5f * terrainScale_;
 
-    // Generate heights using fbm
-    std::vector<std::vector<float>> heights(N, std::vector<float>(N));
-
-    // Fill heights
-    for (int z = 0; z < N; ++z) for (int x = 0; x < N; ++x) heights[z][x] = fbm(x * 0.06f, z * 0.06f) * heightScale_;
+    // Grid placement: world position of sample (0,0) and spacing between samples
+    float originX = -half, originZ = -half, spacing = terrainScale_;
+
+    // Generate heights
+    Heightfield heights(N, heightLayout_);
+
+    if (dem_) {
+        // DEM: an N x N window at demLevel_ centered on the camera, paged in from the tile store
+        demCenterX_ = frame_.pos.x / terrainScale_ + (dem_->width() - 1) * 0.5;
+        demCenterZ_ = frame_.pos.z / terrainScale_ + (dem_->height() - 1) * 0.5;
+        readDemWindow(demCenterX_, demCenterZ_, demLevel_, terrainScale_, heightScale_, heights, originX, originZ, spacing);
+    } else if (heightBackend_ == HeightBackend::Gpu && heightGenShader_) {
+        // GPU fbm: render now, the mesh is built in pollGpuHeights() once the readback lands
+        dispatchGpuHeights(N);
+        return;
+    } else {
+        // Fill heights using fbm
+        for (int z = 0; z < N; ++z) for (int x = 0; x < N; ++x) heights.at(x, z) = fbm(x * 0.06f, z * 0.06f) * heightScale_;
+    }
+    buildTerrainFromHeights(std::move(heights), originX, originZ, spacing);
+}
 
-    // Generate vertices
-    vertices.resize(N * N);
-    for (int z = 0; z < N; ++z) for (int x = 0; x < N; ++x) {
-        Vertex &V = vertices[z * N + x];
-        V.pos = glm::vec3(x * terrainScale_ - half, heights[z][x], z * terrainScale_ - half);
-        V.uv  = glm::vec2((float)x / (N - 1) * textureTile_, (float)z / (N - 1) * textureTile_);
+// N x N window of DEM level `level` around level-0 sample (centerX, centerZ),
+// in world units; false when no DEM is loaded. Safe off the render thread.
+bool Engine::readDemWindow(double centerX, double centerZ, int level, float scale, float heightScale, Heightfield &heights,
+                           float &originX, float &originZ, float &spacing) {
+    int N = heights.size();
+    int64_t step = (int64_t)1 << level;
+    int64_t x0 = (int64_t)std::llround(centerX / step) - N / 2, z0 = (int64_t)std::llround(centerZ / step) - N / 2;
+    std::vector<float> window((size_t)N * N);
+    {
+        std::lock_guard<std::mutex> lock(demMutex_);
+        if (!dem_) return false;
+        dem_->readRegion(level, x0, z0, N, N, window.data());
+        originX = (float)((x0 * step - (dem_->width() - 1) * 0.5) * scale);
+        originZ = (float)((z0 * step - (dem_->height() - 1) * 0.5) * scale);
     }
+    for (float &h : window) h *= heightScale;
+    heights.assignRowMajor(window.data());
+    spacing = scale * step;
+    return true;
+}
+
+// Interleaved position / normal / uv vertices and triangle indices of a
+// height grid (CPU only, so it also runs on JobPool)
+void Engine::buildMeshArrays(const Heightfield &heights, float originX, float originZ, float spacing, float half, float textureTile,
+                             NormalMode normalMode, std::vector<float> &inter, std::vector<GLuint> &indices) {
+    std::vector<glm::vec3> positions; std::vector<glm::vec3> normals;
+    int N = heights.size();
+
+    // Generate vertex positions
+    positions.resize((size_t)N * N);
+    for (int z = 0; z < N; ++z) for (int x = 0; x < N; ++x)
+        positions[(size_t)z * N + x] = glm::vec3(originX + x * spacing, heights.at(x, z), originZ + z * spacing);
 
-    // Generate indices (two triangles per quad)
+    // Generate indices (two triangles per quad); 32-bit indices, size_t math
+    indices.clear(); indices.reserve((size_t)(N - 1) * (N - 1) * 6);
     for (int z = 0; z < N - 1; ++z) for (int x = 0; x < N - 1; ++x) {
-        int tl = z * N + x; int tr = tl + 1; int bl = (z + 1) * N + x; int br = bl + 1;
-        if (tl < 0 || tr < 0 || bl < 0 || br < 0) continue;
-        if (tl >= N*N || tr >= N*N || bl >= N*N || br >= N*N) continue;
-        if (tl == bl || bl == br || br == tl) continue;
-        if (tl == br || br == tr || tr == tl) continue;
+        GLuint tl = (GLuint)((size_t)z * N + x); GLuint tr = tl + 1; GLuint bl = (GLuint)((size_t)(z + 1) * N + x); GLuint br = bl + 1;
         indices.push_back(tl); indices.push_back(bl); indices.push_back(br);
         indices.push_back(tl); indices.push_back(br); indices.push_back(tr);
     }
 
-    // Compute normals (average face normals)
-    std::vector<glm::vec3> normalSum(vertices.size(), glm::vec3(0.0f));
-    for (size_t i = 0; i < indices.size(); i += 3) {
-        unsigned int i0 = indices[i]; unsigned int i1 = indices[i + 1]; unsigned int i2 = indices[i + 2];
-        glm::vec3 p0 = vertices[i0].pos; glm::vec3 p1 = vertices[i1].pos; glm::vec3 p2 = vertices[i2].pos;
-        glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
-        normalSum[i0] += normal; normalSum[i1] += normal; normalSum[i2] += normal;
+    // Compute normals (see terrain/normals.h for the two methods)
+    normals.resize(positions.size());
+    if (normalMode == NormalMode::Stencil) computeNormalsStencil(heights, spacing, normals.data());
+    else computeNormalsAccumulate(positions.data(), positions.size(), indices.data(), indices.size(), normals.data());
+
+    // Interleave data
+    inter.clear(); inter.reserve(positions.size() * 8);
+    for (int z = 0; z < N; ++z) for (int x = 0; x < N; ++x) {
+        const glm::vec3 &p = positions[(size_t)z * N + x]; const glm::vec3 &n = normals[(size_t)z * N + x];
+        // UVs anchored to world space so a re-centered DEM window doesn't swim
+        glm::vec2 uv((p.x + half) / (2.0f * half) * textureTile, (p.z + half) / (2.0f * half) * textureTile);
+        inter.insert(inter.end(), {p.x, p.y, p.z, n.x, n.y, n.z, uv.x, uv.y});
     }
+}
 
-    // Normalize summed normals
-    for (size_t i = 0; i < vertices.size(); ++i) vertices[i].normal = glm::normalize(normalSum[i]);
+void Engine::buildTerrainFromHeights(Heightfield heights, float originX, float originZ, float spacing) {
+    std::vector<float> inter; std::vector<GLuint> indices;
+    if (terrainRenderMode_ == TerrainRenderMode::Mesh) {
+        float half = (heights.size() - 1) * 0.5f * terrainScale_;
+        buildMeshArrays(heights, originX, originZ, spacing, half, textureTile_, normalMode_, inter, indices);
+    }
+    uploadTerrain(makeTerrainGrid(std::move(heights), originX, originZ, spacing), inter, indices);
+}
+
+// GL side of a terrain build: mesh buffers (or the height texture in
+// VBO-less mode), then the grid is published for queries
+void Engine::uploadTerrain(std::shared_ptr<TerrainGrid> grid, const std::vector<float> &inter, const std::vector<GLuint> &indices) {
+    gridOriginX_ = grid->originX; gridOriginZ_ = grid->originZ; gridSpacing_ = grid->spacing;
+
+    // VBO-less mode: only the heights go to the GPU, vertex.glsl rebuilds the rest
+    if (terrainRenderMode_ == TerrainRenderMode::HeightTexture) {
+        if (vao_) { glDeleteBuffers(1, &vbo_); glDeleteBuffers(1, &ebo_); glDeleteVertexArrays(1, &vao_); vao_ = vbo_ = ebo_ = 0; indexCount_ = 0; }
+        uploadHeightTexture(grid->heights);
+        heightQuery_.publish(std::move(grid));
+        navGridPublished();
+        return;
+    }
+    if (heightTex_) { glDeleteTextures(1, &heightTex_); heightTex_ = 0; heightTexSize_ = 0; }
+    auto uploadStart = Clock::now();
 
-    // TODO: Upload to member buffers (interleave here)
     // Cleanup old
-    if (vao_) { glDeleteBuffers(1, &vbo_); glDeleteBuffers(1, &ebo_); glDeleteVertexArrays(1, &vao_); }
+    if (vao_) { gl_.forgetVertexArray(vao_); glDeleteBuffers(1, &vbo_); glDeleteBuffers(1, &ebo_); glDeleteVertexArrays(1, &vao_); }
     glGenVertexArrays(1, &vao_); glGenBuffers(1, &vbo_); glGenBuffers(1, &ebo_);
-    glBindVertexArray(vao_);
-
-    // Interleave data
-    std::vector<float> inter; inter.reserve(vertices.size() * 8);
-    for (auto &v : vertices) inter.insert(inter.end(), {v.pos.x, v.pos.y, v.pos.z, v.normal.x, v.normal.y, v.normal.z, v.uv.x, v.uv.y});
+    gl_.bindVertexArray(vao_);
 
     // create and upload buffers
     glBindBuffer(GL_ARRAY_BUFFER, vbo_); glBufferData(GL_ARRAY_BUFFER, inter.size() * sizeof(float), inter.data(), GL_STATIC_DRAW);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_); glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
     indexCount_ = indices.size();
+    lastUploadBytes_ = inter.size() * sizeof(float) + indices.size() * sizeof(GLuint);
 
     // vertex attributes
     GLsizei stride = 8 * sizeof(float);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0); glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float))); glEnableVertexAttribArray(1);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float))); glEnableVertexAttribArray(2);
-    glBindVertexArray(0);
+    gl_.bindVertexArray(0);
+    lastUploadMs_ = std::chrono::duration<float, std::milli>(Clock::now() - uploadStart).count();
+
+    // Keep the grid for collision queries against what is actually drawn
+    heightQuery_.publish(std::move(grid));
+    navGridPublished();
+}
+
+// Query grid (min/max pyramid included) over heights; CPU only
+std::shared_ptr<TerrainGrid> Engine::makeTerrainGrid(Heightfield heights, float originX, float originZ, float spacing) {
+    std::shared_ptr<TerrainGrid> grid = std::make_shared<TerrainGrid>();
+    grid->heights = std::move(heights); grid->originX = originX; grid->originZ = originZ; grid->spacing = spacing;
+    grid->buildPyramid();
+    return grid;
 }
 
 void Engine::uploadMeshToGPU() {
+    PROFILE_FUNCTION();
     // Mesh upload is integrated into buildTerrainMesh for simplicity (in this refactor)
 }
 
+void Engine::createTerrainPatch() {
+    // One PATCH_QUADS x PATCH_QUADS grid in integer grid units (x, 0, z), instanced over the terrain
+    const int P = PATCH_QUADS + 1;
+    std::vector<float> verts; verts.reserve((size_t)P * P * 3);
+    for (int z = 0; z < P; ++z) for (int x = 0; x < P; ++x) verts.insert(verts.end(), {(float)x, 0.0f, (float)z});
+    std::vector<GLuint> idx; idx.reserve((size_t)PATCH_QUADS * PATCH_QUADS * 6);
+    for (int z = 0; z < PATCH_QUADS; ++z) for (int x = 0; x < PATCH_QUADS; ++x) {
+        GLuint tl = z * P + x; GLuint tr = tl + 1; GLuint bl = (z + 1) * P + x; GLuint br = bl + 1;
+        idx.insert(idx.end(), {tl, bl, br, tl, br, tr}); // same split as buildTerrainMesh
+    }
+
+    glGenVertexArrays(1, &patchVAO_); glGenBuffers(1, &patchVBO_); glGenBuffers(1, &patchEBO_);
+    gl_.bindVertexArray(patchVAO_);
+    glBindBuffer(GL_ARRAY_BUFFER, patchVBO_); glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(float), verts.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, patchEBO_); glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0); glEnableVertexAttribArray(0);
+    gl_.bindVertexArray(0);
+    patchIndexCount_ = (GLsizei)idx.size();
+}
+
+// ---------------- GPU height generation ----------------
+void Engine::dispatchGpuHeights(int N) {
+    // (Re)create the R32F target and the pack buffer when the grid size changes
+    if (heightGenSize_ != N) {
+        if (heightGenFBO_) {
+            gl_.forgetFramebuffer(heightGenFBO_); gl_.forgetTexture(heightGenTex_);
+            glDeleteFramebuffers(1, &heightGenFBO_); glDeleteTextures(1, &heightGenTex_); glDeleteBuffers(1, &heightGenPBO_);
+        }
+        glGenTextures(1, &heightGenTex_); gl_.bindTexture(0, GL_TEXTURE_2D, heightGenTex_);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, N, N, 0, GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenFramebuffers(1, &heightGenFBO_); gl_.bindFramebuffer(heightGenFBO_);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, heightGenTex_, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) std::cerr << "Height generation framebuffer incomplete\n";
+        glGenBuffers(1, &heightGenPBO_); glBindBuffer(GL_PIXEL_PACK_BUFFER, heightGenPBO_);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)N * N * sizeof(float), nullptr, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        heightGenSize_ = N;
+    }
+    if (heightGenFence_) { glDeleteSync(heightGenFence_); heightGenFence_ = 0; } // newer request supersedes
+
+    // Render one fragment per sample. Timestamps rather than GL_TIME_ELAPSED:
+    // GUI-triggered builds run inside the timed "gui" pass, and elapsed-time
+    // queries can't nest.
+    if (!heightGenTimer_[0]) glGenQueries(2, heightGenTimer_);
+    glQueryCounter(heightGenTimer_[0], GL_TIMESTAMP);
+    GLint viewport[4]; glGetIntegerv(GL_VIEWPORT, viewport);
+    gl_.bindFramebuffer(heightGenFBO_);
+    gl_.viewport(0, 0, N, N);
+    gl_.disable(GL_DEPTH_TEST);
+    gl_.useProgram(heightGenShader_);
+    glUniform1f(glGetUniformLocation(heightGenShader_, "heightScale"), heightScale_);
+    glUniform1f(glGetUniformLocation(heightGenShader_, "noiseFreq"), 0.06f);
+    gl_.bindVertexArray(skyVAO_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    // Asynchronous readback into the PBO; the fence tells pollGpuHeights when it landed
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, heightGenPBO_);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, N, N, GL_RED, GL_FLOAT, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glQueryCounter(heightGenTimer_[1], GL_TIMESTAMP);
+    heightGenFence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    gl_.bindFramebuffer(0);
+    gl_.viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    gl_.enable(GL_DEPTH_TEST);
+}
+
+// Copy a landed readback out of the PBO into heights (resized to the
+// generated grid); false while it is still in flight
+bool Engine::readGpuHeights(bool wait, Heightfield &heights) {
+    if (!heightGenFence_) return false;
+    GLenum r = glClientWaitSync(heightGenFence_, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000ull : 0);
+    if (r != GL_ALREADY_SIGNALED && r != GL_CONDITION_SATISFIED) return false;
+    glDeleteSync(heightGenFence_); heightGenFence_ = 0;
+
+    int N = heightGenSize_;
+    heights.resize(N, heightLayout_);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, heightGenPBO_);
+    if (void* p = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)N * N * sizeof(float), GL_MAP_READ_BIT)) {
+        heights.assignRowMajor((const float*)p);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // GPU time of the render + pack; both timestamps precede the fence, so
+    // the results are ready
+    GLuint64 t0 = 0, t1 = 0;
+    glGetQueryObjectui64v(heightGenTimer_[0], GL_QUERY_RESULT, &t0);
+    glGetQueryObjectui64v(heightGenTimer_[1], GL_QUERY_RESULT, &t1);
+    gpuGenMs_ = (float)((t1 - t0) * 1e-6);
+    return true;
+}
+
+bool Engine::pollGpuHeights(bool wait) {
+    // Build exactly as the CPU path would
+    Heightfield heights;
+    if (!readGpuHeights(wait, heights)) return false;
+    float half = (heights.size() - 1) * 0.5f * terrainScale_;
+    buildTerrainFromHeights(std::move(heights), -half, -half, terrainScale_);
+    return true;
+}
+
+bool Engine::compareHeightBackends(float tolerance) {
+    if (!heightGenShader_ || dem_) return false; // procedural terrain only
+    int N = terrainSize_;
+
+    // CPU reference
+    auto t0 = Clock::now();
+    std::vector<float> cpu((size_t)N * N);
+    for (int z = 0; z < N; ++z) for (int x = 0; x < N; ++x) cpu[(size_t)z * N + x] = fbm(x * 0.06f, z * 0.06f) * heightScale_;
+    cpuGenMs_ = std::chrono::duration<float, std::milli>(Clock::now() - t0).count();
+
+    // GPU, waited on synchronously and compared from the readback alone; the
+    // drawn terrain and the query grid stay as they are. A terrain build
+    // still in flight lands first so this dispatch doesn't supersede it.
+    pollGpuHeights(true);
+    dispatchGpuHeights(N);
+    Heightfield gpu;
+    bool read = readGpuHeights(true, gpu);
+
+    maxBackendError_ = 0.0f;
+    if (read)
+        for (int z = 0; z < N; ++z) for (int x = 0; x < N; ++x) maxBackendError_ = std::max(maxBackendError_, std::abs(cpu[(size_t)z * N + x] - gpu.at(x, z)));
+    bool ok = read && maxBackendError_ <= tolerance;
+    std::cout << "Height backends (" << N << "x" << N << "): CPU " << cpuGenMs_ << " ms, GPU " << gpuGenMs_
+              << " ms, max |diff| " << maxBackendError_ << (ok ? " (ok)" : " (over tolerance)") << std::endl;
+    return ok;
+}
+
+void Engine::uploadHeightTexture(const Heightfield &heights) {
+    PROFILE_FUNCTION();
+    int N = heights.size();
+    auto uploadStart = Clock::now();
+    if (!patchVAO_) createTerrainPatch();
+
+    // Reallocate only when the grid size changes; otherwise stream into the existing R32F texture
+    if (!heightTex_ || heightTexSize_ != N) {
+        if (heightTex_) { gl_.forgetTexture(heightTex_); glDeleteTextures(1, &heightTex_); }
+        glGenTextures(1, &heightTex_); gl_.bindTexture(0, GL_TEXTURE_2D, heightTex_);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, N, N, 0, GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        heightTexSize_ = N;
+    }
+    gl_.bindTexture(0, GL_TEXTURE_2D, heightTex_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (const float* rows = heights.rowPointer(0)) glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, N, N, GL_RED, GL_FLOAT, rows);
+    else { std::vector<float> staging((size_t)N * N); heights.toRowMajor(staging.data()); glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, N, N, GL_RED, GL_FLOAT, staging.data()); }
+
+    lastUploadBytes_ = (size_t)N * N * sizeof(float);
+    lastUploadMs_ = std::chrono::duration<float, std::milli>(Clock::now() - uploadStart).count();
+}
+
 GLuint Engine::loadTexture(const char* path) {
+    PROFILE_FUNCTION();
     // Load texture using stb_image
     if (!path) return 0;
     int width = 0, height = 0, nrChannels = 0;
@@ -438,7 +1188,7 @@ GLuint Engine::loadTexture(const char* path) {
         if (!dataf) { std::cerr << "Failed to load HDR texture: " << path << std::endl; return 0; }
 
         // Create OpenGL texture
-        GLuint textureID; glGenTextures(1, &textureID); glBindTexture(GL_TEXTURE_2D, textureID);
+        GLuint textureID; glGenTextures(1, &textureID); gl_.bindTexture(0, GL_TEXTURE_2D, textureID);
         GLenum format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
         GLenum internal = (nrChannels == 4) ? GL_RGBA16F : GL_RGB16F;
 
@@ -464,7 +1214,7 @@ GLuint Engine::loadTexture(const char* path) {
     if (!data) { std::cerr << "Failed to load texture: " << path << std::endl; return 0; }
 
     // Create OpenGL texture
-    GLuint textureID; glGenTextures(1, &textureID); glBindTexture(GL_TEXTURE_2D, textureID);
+    GLuint textureID; glGenTextures(1, &textureID); gl_.bindTexture(0, GL_TEXTURE_2D, textureID);
     GLenum format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
 
     // Upload 8-bit data
@@ -482,8 +1232,9 @@ GLuint Engine::loadTexture(const char* path) {
 }
 
 bool Engine::panorama(const std::string &path) {
+    PROFILE_FUNCTION();
     // Load panorama texture (can be HDR or standard)
-    if (panoramaTexture_) { glDeleteTextures(1, &panoramaTexture_); panoramaTexture_ = 0; }
+    if (panoramaTexture_) { gl_.forgetTexture(panoramaTexture_); glDeleteTextures(1, &panoramaTexture_); panoramaTexture_ = 0; }
     if (path.empty()) return true; // no panorama is valid
     // Load texture
     panoramaTexture_ = loadTexture(path.c_str());
@@ -492,7 +1243,7 @@ bool Engine::panorama(const std::string &path) {
         return false;
     }
     // Ensure the panorama is clamped to edge (prevents seams at the texture borders)
-    glBindTexture(GL_TEXTURE_2D, panoramaTexture_);
+    gl_.bindTexture(0, GL_TEXTURE_2D, panoramaTexture_);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     return true;
@@ -502,19 +1253,194 @@ bool Engine::panorama(const std::string &path) {
 void Engine::cursorPosCallbackStatic(GLFWwindow*, double xpos, double ypos) { if (s_instance_) s_instance_->cursorPosCallback(xpos, ypos); }
 void Engine::keyCallbackStatic(GLFWwindow* window, int key, int scancode, int action, int mods) { if (s_instance_) s_instance_->keyCallback(key, scancode, action, mods); }
 
+// Callbacks run on the main thread and only forward events to the sim thread
 void Engine::cursorPosCallback(double xpos, double ypos) {
     if (firstMouse_) { lastX_ = xpos; lastY_ = ypos; firstMouse_ = false; }
     double xoff = xpos - lastX_; double yoff = lastY_ - ypos;
-    lastX_ = xpos; lastY_ = ypos; xoff *= mouseSensitivity_; yoff *= mouseSensitivity_; yaw_ += (float)xoff; pitch_ += (float)yoff; pitch_ = glm::clamp(pitch_, -89.0f, 89.0f);
+    lastX_ = xpos; lastY_ = ypos; xoff *= mouseSensitivity_; yoff *= mouseSensitivity_;
+    InputEvent e{}; e.type = InputEvent::Look; e.dx = (float)xoff; e.dy = (float)yoff;
+    inputQueue_.push(TimedInput{e, Clock::now()});
 }
 
 void Engine::keyCallback(int key, int, int action, int) {
-    if (key >= 0 && key < 1024) keys_[key] = (action == GLFW_PRESS || action == GLFW_REPEAT); // keep track of key states
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) glfwSetWindowShouldClose(window_, true); // close on escape
-    if (key == GLFW_KEY_SPACE && action == GLFW_PRESS && !jumping_) { jumping_ = true; jumpVel_ = JUMP_VELOCITY; } // ideal 7 for normal jump
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS) writeTrace(); // dump the CPU profile
+    InputEvent e{}; e.type = InputEvent::Key; e.key = key; e.action = action;
+    inputQueue_.push(TimedInput{e, Clock::now()});
+}
+
+void Engine::applyInput(const InputEvent &e) {
+    if (e.type == InputEvent::TickRate) { simTickRate_ = e.hz; simClock_.setTickRate(e.hz); tickRate_.store(e.hz); return; }
+    if (e.type == InputEvent::Look) { yaw_ += e.dx; pitch_ = glm::clamp(pitch_ + e.dy, -89.0f, 89.0f); return; }
+    if (e.key >= 0 && e.key < 1024) keys_[e.key] = (e.action == GLFW_PRESS || e.action == GLFW_REPEAT); // keep track of key states
+    if (e.key == GLFW_KEY_SPACE && e.action == GLFW_PRESS && !jumping_) { jumping_ = true; jumpVel_ = JUMP_VELOCITY; } // ideal 7 for normal jump
+}
+
+// ----------------- Simulation thread -----------------
+SimFrame Engine::makeSimFrame(Clock::time_point tickTime) const {
+    SimFrame f;
+    f.prevPos = prevCameraPos_; f.pos = cameraPos_; f.yaw = yaw_; f.pitch = pitch_;
+    f.tickTime = tickTime; f.step = (float)simClock_.step();
+    f.tick = simClock_.ticks(); f.droppedTicks = simClock_.droppedTicks();
+    f.agentCount = (uint32_t)agents_.size(); f.agentMs = agentMs_; f.broadphaseMs = broadphaseMs_;
+    f.inputTime = lastInputTime_;
+    return f;
+}
+
+void Engine::startSimulation() {
+    if (simRunning_.load()) return;
+    inputBaseTick_ = simClock_.ticks();
+    float rate = tickRate_.load();
+    if (replay_.isOpen()) {
+        // Start exactly where the recording did
+        const InputRecordHeader &h = replay_.header();
+        rate = h.tickRate; tickRate_.store(rate);
+        cameraPos_ = glm::vec3(h.camX, h.camY, h.camZ); yaw_ = h.yaw; pitch_ = h.pitch;
+        std::fill(std::begin(keys_), std::end(keys_), false); jumping_ = false; jumpVel_ = 0.0f;
+    } else if (!recordPath_.empty()) {
+        InputRecordHeader h{rate, cameraPos_.x, cameraPos_.y, cameraPos_.z, yaw_, pitch_};
+        if (!recorder_.open(recordPath_, h)) std::cerr << "Failed to open input recording: " << recordPath_ << std::endl;
+    }
+    simTickRate_ = rate; simClock_.setTickRate(rate);
+    prevCameraPos_ = cameraPos_;
+    simFrames_.reset(makeSimFrame(Clock::now()));
+    simRunning_.store(true);
+    simThread_ = std::thread(&Engine::simLoop, this);
 }
 
+void Engine::stopSimulation() {
+    simRunning_.store(false);
+    if (simThread_.joinable()) simThread_.join();
+    recorder_.close(simClock_.ticks() - inputBaseTick_);
+}
+
+void Engine::simLoop() {
+    PROFILE_THREAD("sim");
+    auto last = Clock::now();
+    while (simRunning_.load(std::memory_order_acquire)) {
+        // Tick rate changes apply before this batch and are logged like input;
+        // a replay takes them from its log instead
+        float rate = tickRate_.load(std::memory_order_relaxed);
+        if (!replay_.isOpen() && rate != simTickRate_) {
+            simTickRate_ = rate; simClock_.setTickRate(rate);
+            InputEvent change{}; change.type = InputEvent::TickRate; change.hz = rate;
+            recorder_.write(simClock_.ticks() - inputBaseTick_, change);
+        }
+        simClock_.setMaxSteps(maxSimSteps_.load(std::memory_order_relaxed));
+
+        auto now = Clock::now();
+        int steps = simClock_.advance(std::chrono::duration<double>(now - last).count());
+        last = now;
+
+        // Live input applies before this batch's first tick (and is recorded
+        // against it); during a replay it is dropped in favour of the log
+        uint64_t first = simClock_.ticks() - steps - inputBaseTick_;
+        TimedInput in;
+        while (inputQueue_.pop(in)) {
+            if (replay_.isOpen()) continue;
+            applyInput(in.event);
+            recorder_.write(first, in.event);
+            lastInputTime_ = std::max(lastInputTime_, in.time);
+        }
+        InputEvent e;
+        std::shared_ptr<const TerrainGrid> grid = heightQuery_.snapshot();
+        for (int i = 0; i < steps; ++i) {
+            PROFILE_ZONE("sim tick");
+            if (replay_.isOpen()) {
+                while (replay_.next(first + i, e)) applyInput(e);
+                if (replay_.finished(first + i)) {
+                    replay_.close(); replayDone_.store(true);
+                    if (window_) glfwPostEmptyEvent();   // wake mainloop out of glfwWaitEvents
+                }
+            }
+            prevCameraPos_ = cameraPos_; updateMovement((float)simClock_.step());
+            if (grid) {
+                auto t0 = Clock::now();
+                {
+                    PROFILE_ZONE("agents");
+                    syncAgents(*grid);
+                    agents_.update(*grid, (float)simClock_.step());
+                }
+                auto t1 = Clock::now();
+                {
+                    // Cells of 4 units, anchored to the grid so 16 fit a terrain patch side
+                    PROFILE_ZONE("broadphase");
+                    agentHash_.setCell(4.0f * grid->spacing, grid->originX, grid->originZ);
+                    agentHash_.build(agents_.posX(), agents_.posZ(), agents_.size());
+                }
+                agentMs_ = std::chrono::duration<float, std::milli>(t1 - t0).count();
+                broadphaseMs_ = std::chrono::duration<float, std::milli>(Clock::now() - t1).count();
+            }
+        }
+
+        // Hand the new state over; pos is where the sim stood alpha ticks ago
+        auto behind = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(simClock_.alpha() * simClock_.step()));
+        if (steps) { simFrames_.back() = makeSimFrame(now - behind); simFrames_.publish(); }
+
+        // Sleep until the next tick is due
+        std::this_thread::sleep_until(now - behind + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(simClock_.step())));
+    }
+}
+
+void Engine::syncAgents(const TerrainGrid &grid) {
+    size_t target = (size_t)std::max(agentTarget_.load(std::memory_order_relaxed), 0);
+    while (agents_.size() > target) agents_.remove(agents_.size() - 1);
+    if (agents_.size() == target) return;
+    // Spawn over the current grid with random headings, walking to sprinting speed
+    agents_.reserve(target);
+    float extent = (grid.heights.size() - 1) * grid.spacing;
+    std::mt19937 rng(agentSeed_++);
+    std::uniform_real_distribution<float> u(0.0f, extent), ang(0.0f, 6.2831853f), spd(1.0f, moveSpeed_ * SPRINT_MULTIPLIER);
+    while (agents_.size() < target) {
+        float x = grid.originX + u(rng), z = grid.originZ + u(rng);
+        agents_.spawn(glm::vec3(x, grid.height(x, z) + 1.7f, z), ang(rng), spd(rng));
+    }
+}
+
+bool Engine::recordInput(const std::string &path) { recordPath_ = path; return !path.empty(); }
+bool Engine::replayInput(const std::string &path) {
+    if (!replay_.open(path)) { std::cerr << "Failed to open input replay: " << path << std::endl; return false; }
+    return true;
+}
+void Engine::setFrameTimingLog(const std::string &path) { timingLogPath_ = path; }
+void Engine::setTracePath(const std::string &path) { tracePath_ = path; }
+bool Engine::writeTrace() {
+    std::string path = tracePath_.empty() ? "nut_trace.json" : tracePath_;
+    if (!Profiler::writeChromeTrace(path)) return false;
+    std::cout << "Wrote CPU trace " << path << std::endl;
+    return true;
+}
+bool Engine::isReplaying() const { return replay_.isOpen() && !replayDone_.load(); }
+
+int Engine::getAgentCount() const { return agentTarget_.load(); }
+void Engine::setAgentCount(int n) { agentTarget_.store(std::max(n, 0)); }
+float Engine::getAgentUpdateMs() const { return frame_.agentMs; }
+float Engine::getBroadphaseMs() const { return frame_.broadphaseMs; }
+uint32_t Engine::getGLCallsIssued() const { return gl_.lastFrame().issued; }
+uint32_t Engine::getGLCallsElided() const { return gl_.lastFrame().elided; }
+bool Engine::getSkyLast() const { return skyLast_; }
+void Engine::setSkyLast(bool v) { skyLast_ = v; }
+bool Engine::getDepthPrepass() const { return depthPrepass_; }
+void Engine::setDepthPrepass(bool v) { depthPrepass_ = v; }
+uint64_t Engine::getSkyFragments() const { return skyFragments_; }
+uint64_t Engine::getTerrainFragments() const { return terrainFragments_; }
+bool Engine::getRenderThread() const { return renderThreadEnabled_; }
+void Engine::setRenderThread(bool enabled) { renderThreadEnabled_ = enabled; }
+float Engine::getInputLatencyMs() const { return inputLatencyCount_ ? inputLatencyMs_[(inputLatencyCount_ - 1) % LATENCY_WINDOW] : 0.0f; }
+float Engine::getSceneGpuMs() const { return gpuTimer_.frameMs(); }
+bool Engine::getDynamicResolution() const { return dynamicRes_; }
+void Engine::setDynamicResolution(bool v) { if (v != dynamicRes_) dynRes_.reset(); dynamicRes_ = v; }
+float Engine::getResolutionTargetMs() const { return dynRes_.targetMs(); }
+void Engine::setResolutionTargetMs(float ms) { dynRes_.setTargetMs(ms); }
+float Engine::getResolutionScale() const { return dynamicRes_ ? dynRes_.scale() : 1.0f; }
+int Engine::getSceneWidth() const { return sceneW_; }
+int Engine::getSceneHeight() const { return sceneH_; }
+const DynamicResolution& Engine::getDynamicResolutionController() const { return dynRes_; }
+const GpuPassTimer& Engine::getGpuPassTimer() const { return gpuTimer_; }
+const RenderGraph& Engine::getRenderGraph() const { return graph_; }
+
 void Engine::updateMovement(float dt) {
+    PROFILE_FUNCTION();
     // Update camera position based on key states
     // WASD for movement, SPACE for jump (handled in key callback)
     // Simple gravity and jumping mechanics
@@ -540,18 +1466,201 @@ void Engine::updateMovement(float dt) {
 
 // ----------------- Runtime config API -----------------
 void Engine::regenerateTerrain() {
+    PROFILE_FUNCTION();
     buildTerrainMesh();
     uploadMeshToGPU();
 }
 
+// ----------------- DEM heightmaps -----------------
+bool Engine::loadHeightmap(const std::string &path, int64_t width, int64_t height) {
+    std::unique_ptr<DemTileStore> store(new DemTileStore());
+    store->setResidentBudget(tileBudgetMB_ << 20);
+    if (!store->import(path, width, height)) { std::cerr << "Failed to load heightmap: " << path << std::endl; return false; }
+    heightmapPath_ = path;
+    { std::lock_guard<std::mutex> lock(demMutex_); dem_ = std::move(store); }
+    demLevel_ = std::min(demLevel_, dem_->levels() - 1);
+    if (window_) regenerateTerrain();
+    return true;
+}
+
+void Engine::unloadHeightmap() {
+    { std::lock_guard<std::mutex> lock(demMutex_); dem_.reset(); } heightmapPath_.clear();
+    if (window_) regenerateTerrain();
+}
+
+void Engine::dispatchDemWindow() {
+    if (demBuildBusy_.exchange(true)) return;   // one window in flight at a time
+    // Everything the job reads is copied now; dem_ itself is read under demMutex_
+    double cx = frame_.pos.x / terrainScale_ + (dem_->width() - 1) * 0.5, cz = frame_.pos.z / terrainScale_ + (dem_->height() - 1) * 0.5;
+    int N = terrainSize_, level = demLevel_;
+    float scale = terrainScale_, heightScale = heightScale_, tile = textureTile_;
+    NormalMode normalMode = normalMode_; HeightLayout layout = heightLayout_; TerrainRenderMode mode = terrainRenderMode_;
+    uint64_t generation = terrainGeneration_;
+    JobPool::instance().submit([=] {
+        PROFILE_ZONE("dem window");
+        std::unique_ptr<TerrainBuild> b(new TerrainBuild());
+        b->mode = mode; b->centerX = cx; b->centerZ = cz; b->generation = generation;
+        Heightfield heights(N, layout);
+        float originX, originZ, spacing;
+        if (readDemWindow(cx, cz, level, scale, heightScale, heights, originX, originZ, spacing)) {
+            if (mode == TerrainRenderMode::Mesh) buildMeshArrays(heights, originX, originZ, spacing, (N - 1) * 0.5f * scale, tile, normalMode, b->vertices, b->indices);
+            b->grid = makeTerrainGrid(std::move(heights), originX, originZ, spacing);
+        }
+        std::lock_guard<std::mutex> lock(demBuildMutex_);
+        demBuildDone_ = std::move(b);
+    });
+}
+
+bool Engine::pollDemWindow() {
+    std::unique_ptr<TerrainBuild> b;
+    { std::lock_guard<std::mutex> lock(demBuildMutex_); b = std::move(demBuildDone_); }
+    if (!b) return false;
+    demBuildBusy_.store(false);
+    // Dropped when the terrain was rebuilt or reconfigured in the meantime
+    if (!b->grid || b->generation != terrainGeneration_ || b->mode != terrainRenderMode_) return false;
+    PROFILE_ZONE("dem window upload");
+    demCenterX_ = b->centerX; demCenterZ_ = b->centerZ;
+    uploadTerrain(std::move(b->grid), b->vertices, b->indices);
+    return true;
+}
+
+bool Engine::demNeedsRecenter() const {
+    double cx = frame_.pos.x / terrainScale_ + (dem_->width() - 1) * 0.5, cz = frame_.pos.z / terrainScale_ + (dem_->height() - 1) * 0.5;
+    double limit = (terrainSize_ / 4) * (double)((int64_t)1 << demLevel_);
+    return std::abs(cx - demCenterX_) > limit || std::abs(cz - demCenterZ_) > limit;
+}
+
+const std::string& Engine::getHeightmapPath() const { return heightmapPath_; }
+size_t Engine::getTileBudgetMB() const { return tileBudgetMB_; }
+void Engine::setTileBudgetMB(size_t mb) { tileBudgetMB_ = std::max<size_t>(mb, 1); std::lock_guard<std::mutex> lock(demMutex_); if (dem_) dem_->setResidentBudget(tileBudgetMB_ << 20); }
+int Engine::getDemLevel() const { return demLevel_; }
+void Engine::setDemLevel(int level) { demLevel_ = std::max(0, dem_ ? std::min(level, dem_->levels() - 1) : level); }
+
+// Applied by the sim thread at its next wake-up
+float Engine::getTickRate() const { return tickRate_.load(); }
+void Engine::setTickRate(float hz) { tickRate_.store(glm::clamp(hz, 1.0f, 1000.0f)); }
+int Engine::getMaxSimSteps() const { return maxSimSteps_.load(); }
+void Engine::setMaxSimSteps(int n) { maxSimSteps_.store(std::max(n, 1)); }
+uint64_t Engine::getDroppedSimTicks() const { return frame_.droppedTicks; }
+
+glm::vec3 Engine::getTerrainNormal(float wx, float wz) const { return heightQuery_.normal(wx, wz); }
+const HeightQuery& Engine::heightQuery() const { return heightQuery_; }
+bool Engine::raycastTerrain(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, RayHit &hit) const {
+    return heightQuery_.raycast(origin, dir, maxT, hit);
+}
+
+bool Engine::pickTerrain(double sx, double sy, RayHit &hit) const {
+    if (!window_) return false;
+    int w, h; glfwGetWindowSize(window_, &w, &h);
+    if (w <= 0 || h <= 0) return false;
+    // Unproject the cursor through the last drawn frame's view-projection
+    glm::mat4 viewProj; glm::vec3 eye;
+    {
+        std::lock_guard<std::mutex> lock(cameraMutex_);
+        viewProj = lastViewProj_; eye = lastEye_;
+    }
+    glm::mat4 inv = glm::inverse(viewProj);
+    float nx = (float)(2.0 * sx / w - 1.0), ny = (float)(1.0 - 2.0 * sy / h);
+    glm::vec4 nearP = inv * glm::vec4(nx, ny, -1.0f, 1.0f), farP = inv * glm::vec4(nx, ny, 1.0f, 1.0f);
+    glm::vec3 a = glm::vec3(nearP.x, nearP.y, nearP.z) / nearP.w, b = glm::vec3(farP.x, farP.y, farP.z) / farP.w;
+    return raycastTerrain(eye, b - a, glm::length(b - eye), hit);
+}
+
+void Engine::checkLineOfSight(const glm::vec3* from, const glm::vec3* to, size_t count, uint64_t* visibleBits) const {
+    heightQuery_.lineOfSightBatch(from, to, count, visibleBits);
+}
+
+// A grid with a different size or placement than the old one needs a full build
+bool Engine::navLayoutChanged(const TerrainGrid *old, const TerrainGrid &grid) {
+    return !old || old->heights.size() != grid.heights.size() || old->originX != grid.originX || old->originZ != grid.originZ || old->spacing != grid.spacing;
+}
+
+void Engine::syncNavigation() {
+    std::unique_lock<std::mutex> lock(navMutex_);
+    navUsed_ = true;
+    if (navBuilding_) return;   // queries use the current graph until the build lands
+    std::shared_ptr<const TerrainGrid> grid = heightQuery_.snapshot();
+    if (grid == navGrid_) return;
+    if (!grid) { navGrid_.reset(); paths_.build(nullptr); return; }
+    bool full = navLayoutChanged(navGrid_.get(), *grid);
+    int N = grid->heights.size();
+    int x0 = N, z0 = N, x1 = -1, z1 = -1;
+    if (!full) {
+        // Same placement: rebuild only around the samples that changed
+        for (int z = 0; z < N; ++z) for (int x = 0; x < N; ++x)
+            if (grid->heights.at(x, z) != navGrid_->heights.at(x, z)) { x0 = std::min(x0, x); x1 = std::max(x1, x); z0 = std::min(z0, z); z1 = std::max(z1, z); }
+        // Most of the grid changed (regenerated terrain): as costly as a full build
+        full = x1 >= 0 && (int64_t)(x1 - x0 + 1) * (z1 - z0 + 1) * 2 > (int64_t)N * N;
+    }
+    if (full) { navBuilding_ = true; lock.unlock(); dispatchNavBuild(); return; }
+    navGrid_ = grid;
+    if (x1 >= 0) paths_.updateRegion(grid, x0, z0, x1, z1);
+}
+
+// After every grid publish: once navigation is in use, a new layout starts
+// its full build now rather than at the next query
+void Engine::navGridPublished() {
+    std::unique_lock<std::mutex> lock(navMutex_);
+    if (!navUsed_ || navBuilding_) return;
+    std::shared_ptr<const TerrainGrid> grid = heightQuery_.snapshot();
+    if (!grid || !navLayoutChanged(navGrid_.get(), *grid)) return;
+    navBuilding_ = true;
+    lock.unlock();
+    dispatchNavBuild();
+}
+
+// Builds the latest published grid; PathFinder swaps the graph in atomically,
+// so concurrent queries see either the old graph or the new one. A grid
+// published during the build is picked up by the next query.
+void Engine::dispatchNavBuild() {
+    JobPool::instance().submit([this] {
+        std::shared_ptr<const TerrainGrid> grid = heightQuery_.snapshot();
+        {
+            PROFILE_ZONE("nav build");
+            paths_.build(grid);
+        }
+        std::lock_guard<std::mutex> lock(navMutex_);
+        navGrid_ = std::move(grid);
+        navBuilding_ = false;
+    });
+}
+
+bool Engine::findPath(const glm::vec3 &from, const glm::vec3 &to, std::vector<glm::vec3> &out) {
+    syncNavigation();
+    return paths_.findPath(from, to, out);
+}
+
+void Engine::findPaths(const PathFinder::Request* requests, size_t count, std::vector<std::vector<glm::vec3>> &out) {
+    syncNavigation();
+    paths_.findPaths(requests, count, out);
+}
+
+void Engine::getTerrainHeights(const float* xs, const float* zs, size_t count, float* heights, float* nx, float* ny, float* nz) const {
+    heightQuery_.queryBatch(xs, zs, count, heights, nx, ny, nz);
+}
+
 int Engine::getTerrainSize() const { return terrainSize_; }
-void Engine::setTerrainSize(int v) { terrainSize_ = v; }
+static_assert(6 * (int64_t)(MAX_TERRAIN_SIZE - 1) * (MAX_TERRAIN_SIZE - 1) <= INT_MAX, "terrain index count must fit the GLsizei draw count");
+void Engine::setTerrainSize(int v) { terrainSize_ = std::max(2, std::min(v, MAX_TERRAIN_SIZE)); }
 float Engine::getTerrainScale() const { return terrainScale_; }
 void Engine::setTerrainScale(float v) { terrainScale_ = v; }
 float Engine::getHeightScale() const { return heightScale_; }
 void Engine::setHeightScale(float v) { heightScale_ = v; }
 float Engine::getTextureTile() const { return textureTile_; }
 void Engine::setTextureTile(float v) { textureTile_ = v; }
+HeightLayout Engine::getHeightLayout() const { return heightLayout_; }
+void Engine::setHeightLayout(HeightLayout l) { heightLayout_ = l; }
+HeightBackend Engine::getHeightBackend() const { return heightBackend_; }
+void Engine::setHeightBackend(HeightBackend b) { heightBackend_ = b; }
+float Engine::getCpuGenMs() const { return cpuGenMs_; }
+float Engine::getGpuGenMs() const { return gpuGenMs_; }
+float Engine::getMaxBackendError() const { return maxBackendError_; }
+TerrainRenderMode Engine::getTerrainRenderMode() const { return terrainRenderMode_; }
+void Engine::setTerrainRenderMode(TerrainRenderMode m) { terrainRenderMode_ = m; }
+size_t Engine::getLastUploadBytes() const { return lastUploadBytes_; }
+float Engine::getLastUploadMs() const { return lastUploadMs_; }
+NormalMode Engine::getNormalMode() const { return normalMode_; }
+void Engine::setNormalMode(NormalMode m) { normalMode_ = m; }
 
 const std::string& Engine::getPanoramaPath() const { return panoramaPath_; }
 void Engine::setPanoramaPath(const std::string &p) { panoramaPath_ = p; }
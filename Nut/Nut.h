@@ -4,13 +4,79 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <string>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/camera_path.h"
+#include "core/input_record.h"
+#include "core/sim_clock.h"
+#include "core/spsc_queue.h"
+#include "core/triple_buffer.h"
+#include "render/dynamic_resolution.h"
+#include "render/frame_uniforms.h"
+#include "render/gl_state.h"
+#include "render/gpu_timer.h"
+#include "render/headless_context.h"
+#include "render/render_graph.h"
+#include "terrain/normals.h"
+#include "terrain/heightfield.h"
+#include "terrain/height_query.h"
+#include "world/agents.h"
+#include "world/pathfinder.h"
+#include "world/spatial_hash.h"
 
 // forward-declare GUI class (defined in Nut/gui)
 class GUI;
+// out-of-core heightmap tiles (defined in Nut/terrain/dem.h)
+class DemTileStore;
 
 using Clock = std::chrono::high_resolution_clock;
 
+// How terrain reaches the GPU.
+//  Mesh:          interleaved 8-float VBO + index buffer from buildTerrainMesh
+//  HeightTexture: R32F height texture + one reusable instanced grid patch;
+//                 vertex.glsl rebuilds position, normal and uv per vertex
+enum class TerrainRenderMode { Mesh = 0, HeightTexture = 1 };
+
+// Where procedural heights are computed.
+//  Cpu: fbm on the CPU inside buildTerrainMesh
+//  Gpu: heightgen_frag.glsl renders into an R32F target, read back through a
+//       PBO + fence; the mesh and collision grid update when it lands
+enum class HeightBackend { Cpu = 0, Gpu = 1 };
+
+// Immutable result of a simulation tick, handed to the render thread.
+// The renderer interpolates prevPos -> pos by the time elapsed since tickTime.
+struct SimFrame {
+    glm::vec3 prevPos, pos;
+    float yaw, pitch;
+    Clock::time_point tickTime;  // wall time that pos corresponds to
+    float step;                  // tick length in seconds
+    uint64_t tick, droppedTicks;
+    uint32_t agentCount;         // agents simulated this tick
+    float agentMs;               // cost of the last agent update
+    float broadphaseMs;          // cost of the last agent spatial hash rebuild
+    Clock::time_point inputTime; // callback time of the newest input applied so far
+};
+
+// Input event stamped with its callback time (input latency probe)
+struct TimedInput {
+    InputEvent event;
+    Clock::time_point time;
+};
+
+// Window state the main thread, which owns GLFW, hands to the render
+// thread: published after every batch of events, the latest one taken at
+// the start of each frame
+struct RenderPacket {
+    int fbWidth, fbHeight;
+    uint64_t seq;                // packets published so far
+};
+
 class Engine {
 public:
     Engine();
@@ -29,9 +95,44 @@ public:
     // Enter the main loop and run until window close.
     void mainloop();
 
+    // Threading of mainloop (set before it). By default a render thread owns
+    // the GL context, drawing the latest sim frame and swapping, while the
+    // main thread blocks in glfwWaitEvents: input reaches the sim thread as
+    // soon as it arrives instead of after the next swap, and window state
+    // goes to the render thread as RenderPackets. false keeps rendering,
+    // swapping and event polling on the main thread, as does an attached GUI
+    // (its GLFW backend takes input on the main thread).
+    void setRenderThread(bool enabled);
+    bool getRenderThread() const;
+    // Time from an input callback to the return of the swap that first
+    // shows it, latest sample; mainloop prints percentiles at exit
+    float getInputLatencyMs() const;
+
+    // Headless mode for hosts without a display: initHeadless() replaces
+    // init() with an EGL surfaceless context (Mesa llvmpipe works) and an
+    // offscreen width x height target.
+    bool initHeadless(int width, int height);
+    // Scripted flythrough (after init or initHeadless): `frames` frames
+    // evenly along path on a fixed 60 Hz clock, vsync off, no simulation
+    // thread. Writes the timing log (setFrameTimingLog), a summary to stdout
+    // and the bench report; false if the baseline comparison fails.
+    bool runFlythrough(const CameraPath &path, int frames);
+    // JSON report of the flythrough: frame time, CPU profiler zones and GPU
+    // passes, each as mean / p50 / p95 / p99 / max
+    void setBenchReport(const std::string &path);
+    // Fail the flythrough if a series' mean or p95 exceeds this earlier
+    // report by more than thresholdPct percent
+    void setBenchBaseline(const std::string &path, double thresholdPct);
+    bool isHeadless() const { return headless_.valid(); }
+    // Closed loop over the current terrain, 20 units above the ground
+    CameraPath defaultFlightPath();
+
 private:
     // Internal state (opaque to users)
     GLFWwindow* window_;
+    HeadlessContext headless_;
+    GLuint headlessFbo_, headlessColor_, headlessDepth_;
+    int headlessW_, headlessH_;
     GLuint shaderProgram_;
     GLuint vao_, vbo_, ebo_;
     size_t indexCount_;
@@ -42,6 +143,50 @@ private:
     GLuint skyShader_;
     GLuint skyVAO_, skyVBO_;
 
+    // All engine rendering binds through gl_, which skips redundant calls
+    GLState gl_;
+
+    // Per-frame UBO (Frame block) and the remaining uniform locations,
+    // resolved once after linking in setupPrograms()
+    FrameUniformBuffer frameUbo_;
+    struct TerrainUniforms { GLint heightMode, gridN, patchQuads, patchesPerSide, gridOrigin, gridSpacing, uvParams; } terrainLoc_;
+    struct SkyUniforms { GLint hasPanorama, cloudEnabled, cloudSpeed, cloudScale, cloudOpacity; } skyLoc_;
+    // Values last sent for the rarely changing uniforms; resent only when they differ
+    struct TerrainParams { int heightMode, gridN, patchQuads, patchesPerSide; float originX, originZ, spacing, uvHalf, uvScale; } terrainSent_;
+    struct SkyParams { int hasPanorama, cloudEnabled; float speed, scale, opacity; } skySent_;
+    bool terrainSentValid_, skySentValid_;
+
+    // Frame ordering (see setSkyLast / setDepthPrepass) and the position-only
+    // terrain program used by the depth prepass
+    bool skyLast_, depthPrepass_;
+    // Dynamic resolution: controller, upscale program and this frame's scene size
+    bool dynamicRes_;
+    DynamicResolution dynRes_;
+    GLuint upscaleProgram_;
+    GLint upscaleInvSizeLoc_;
+    int sceneW_, sceneH_;
+    GLuint depthProgram_;
+    TerrainUniforms depthLoc_;
+    TerrainParams depthSent_;
+    bool depthSentValid_;
+    // Per-frame fragment counters, double-buffered and read a frame later so they never stall
+    struct SceneQueries { enum { Sky, Terrain, Count }; GLuint ids[Count]; bool pending; } sceneQueries_[2];
+    uint64_t skyFragments_, terrainFragments_;
+    void drawSky();
+    void drawTerrain(bool depthOnly);
+    TerrainParams terrainParams() const;
+    void sendTerrainParams(const TerrainUniforms &loc, const TerrainParams &tp, TerrainParams &sent, bool &valid);
+    void readSceneQueries(SceneQueries &q);
+
+    // Frame passes, declared anew each frame by declarePasses()
+    RenderGraph graph_;
+    // GPU time of every graph pass (pass hooks)
+    GpuPassTimer gpuTimer_;
+    void declarePasses(int width, int height, GLuint target, SceneQueries &q);
+    bool initResources();
+    void renderFrame(const glm::vec3 &eye, float yaw, float pitch, double time, int width, int height, GLuint target, uint64_t frameIndex);
+    FILE* openTimingLog() const;
+
     // Camera / movement
     glm::vec3 cameraPos_;
     float yaw_, pitch_;
@@ -56,6 +201,59 @@ private:
     Clock::time_point lastFrame_;
     float deltaTime_;
 
+    // Fixed-step simulation on its own thread; rendering interpolates between
+    // the last two ticks. Camera, keys and jump state below belong to the sim
+    // thread once it runs; the render thread only sees frame_.
+    SimClock simClock_;
+    glm::vec3 prevCameraPos_;
+    std::thread simThread_;
+    std::atomic<bool> simRunning_;
+    std::atomic<float> tickRate_;
+    float simTickRate_;                      // sim thread: rate simClock_ runs at
+    std::atomic<int> maxSimSteps_;
+    TripleBuffer<SimFrame> simFrames_;
+    SpscQueue<TimedInput, 1024> inputQueue_; // GLFW callbacks -> sim
+    Clock::time_point lastInputTime_;        // sim thread: newest input applied
+    SimFrame frame_;                         // latest frame taken by the render thread
+    std::mutex demMutex_;                    // dem_ is sampled by the sim thread
+    mutable std::mutex cameraMutex_;         // guards the picking camera below
+    glm::mat4 lastViewProj_; glm::vec3 lastEye_; // camera of the last drawn frame (picking)
+
+    // Render thread (window mode). The main thread publishes RenderPackets;
+    // everything below except renderRunning_ belongs to the drawing thread.
+    bool renderThreadEnabled_;
+    std::thread renderThread_;
+    std::atomic<bool> renderRunning_;
+    TripleBuffer<RenderPacket> packets_;
+    uint64_t packetSeq_;                     // main thread
+    int swapInterval_;                       // applied to the context, -1 unknown
+    Clock::time_point inputShown_;           // newest input already presented
+    static const size_t LATENCY_WINDOW = 4096;
+    std::vector<float> inputLatencyMs_;      // ring of the last LATENCY_WINDOW samples
+    uint64_t inputLatencyCount_;
+    void publishPacket();
+    void renderLoop(FILE* timingLog, Clock::time_point startTime);
+    void drawWindowFrame(uint64_t frameIndex, Clock::time_point startTime, FILE* timingLog);
+
+    // Terrain-walking agents (sim thread); the count follows agentTarget_
+    Agents agents_;
+    std::atomic<int> agentTarget_;
+    uint32_t agentSeed_;
+    float agentMs_;
+    SpatialHash agentHash_;      // agent broadphase, rebuilt after every agent update
+    float broadphaseMs_;
+
+    // Input recording / replay (sim thread) and the per-frame timing log
+    std::string recordPath_;
+    InputRecorder recorder_;
+    InputReplay replay_;
+    uint64_t inputBaseTick_;             // sim tick the recording / replay started at
+    std::atomic<bool> replayDone_;
+    std::string timingLogPath_;
+    std::string tracePath_;              // CPU profile written at exit (and on F9)
+    std::string benchReportPath_, benchBaselinePath_;
+    double benchThresholdPct_;
+
     // constants
     #define TERRAIN_SIZE 512
     #define TERRAIN_SCALE 1.0f
@@ -73,26 +271,33 @@ private:
 
     #define SPRINT_MULTIPLIER 1.9f
 
+    #define PATCH_QUADS 64
+
+    // Largest terrain grid: the mesh draw count 6*(N-1)^2 must fit a GLsizei,
+    // and at this size the interleaved VBO + index buffer are already ~3.7 GB
+    #define MAX_TERRAIN_SIZE 8193
+
     // Input
     bool keys_[1024];
     bool jumping_;
     float jumpVel_;
 
-    // VSync state
-    bool vsyncEnabled_;
+    // VSync state; the drawing thread applies changes before its next swap
+    std::atomic<bool> vsyncEnabled_;
 
     // Instance pointer for static callbacks
     static Engine* s_instance_;
 
-    // GUI manager
-    class GUI; // forward
+    // GUI manager (::GUI, declared above; drawn by the "gui" pass when set)
     GUI* gui_;
 
-    // Configurable constants (moved from macros to members so we can change them at runtime)
-    int terrainSize_;
-    float terrainScale_;
-    float heightScale_;
+    // Configurable constants (moved from macros to members so we can change them at runtime).
+    // Size and scales are atomic: the sim thread's off-grid height fallback reads them.
+    std::atomic<int> terrainSize_;
+    std::atomic<float> terrainScale_;
+    std::atomic<float> heightScale_;
     float textureTile_;
+    NormalMode normalMode_;
 
     // Last-used file paths (for UI / serialization)
     std::string panoramaPath_;
@@ -104,6 +309,64 @@ private:
     float cloudScale_;
     float cloudOpacity_;
 
+    // DEM heightmap (optional; replaces fbm when loaded)
+    std::unique_ptr<DemTileStore> dem_;
+    std::string heightmapPath_;
+    size_t tileBudgetMB_;
+    int demLevel_;                       // mip level the mesh window is built from
+    double demCenterX_, demCenterZ_;     // level-0 sample the current window is centered on
+    bool demNeedsRecenter() const;
+
+    // Re-centring builds the next window (read, mesh, query grid) on JobPool;
+    // the render thread uploads it in pollDemWindow() once it is done
+    struct TerrainBuild {
+        std::shared_ptr<TerrainGrid> grid;   // null if the DEM went away
+        std::vector<float> vertices;         // interleaved mesh, Mesh mode only
+        std::vector<GLuint> indices;
+        TerrainRenderMode mode;
+        double centerX, centerZ;
+        uint64_t generation;                 // terrainGeneration_ at dispatch
+    };
+    std::mutex demBuildMutex_;
+    std::unique_ptr<TerrainBuild> demBuildDone_; // finished, not yet uploaded
+    std::atomic<bool> demBuildBusy_;         // dispatched and not yet consumed
+    uint64_t terrainGeneration_;             // bumped by every synchronous rebuild
+    void dispatchDemWindow();
+    bool pollDemWindow();                    // true when a new window was uploaded
+
+    // VBO-less terrain (TerrainRenderMode::HeightTexture)
+    TerrainRenderMode terrainRenderMode_;
+    GLuint heightTex_; int heightTexSize_;
+    GLuint patchVAO_, patchVBO_, patchEBO_; GLsizei patchIndexCount_;
+    float gridOriginX_, gridOriginZ_, gridSpacing_; // world placement of the current height grid
+    size_t lastUploadBytes_; float lastUploadMs_;    // cost of the last terrain upload
+
+    // Grid of the terrain currently drawn; collision and other queries read it
+    HeightQuery heightQuery_;
+    HeightLayout heightLayout_;
+
+    // HPA* navigation over that grid. Once findPath(s) has been used, a grid
+    // with a new size or placement (or mostly new heights) is built on JobPool
+    // and swapped in, queries keeping the previous graph meanwhile; smaller
+    // height edits rebuild only the touched clusters inline at the next query
+    PathFinder paths_;
+    std::shared_ptr<const TerrainGrid> navGrid_; // grid paths_ currently reflects
+    std::mutex navMutex_;
+    bool navUsed_;                               // findPath(s) called at least once
+    bool navBuilding_;                           // full build in flight on JobPool
+    void syncNavigation();
+    void navGridPublished();
+    void dispatchNavBuild();
+    static bool navLayoutChanged(const TerrainGrid *old, const TerrainGrid &grid);
+
+    // GPU height generation (HeightBackend::Gpu)
+    HeightBackend heightBackend_;
+    GLuint heightGenShader_, heightGenFBO_, heightGenTex_, heightGenPBO_;
+    int heightGenSize_;
+    GLsync heightGenFence_;
+    GLuint heightGenTimer_[2];      // GL_TIMESTAMP queries around the render + pack
+    float cpuGenMs_, gpuGenMs_, maxBackendError_;   // last timings / CPU-GPU comparison
+
 
 public: // Public API
     // Load a panorama (equirectangular) image to be used as the sky. Returns true on success.
@@ -112,6 +375,33 @@ public: // Public API
     // Regenerate terrain mesh with current constants
     void regenerateTerrain();
 
+    // Surface normal of the drawn terrain and the query service behind
+    // getTerrainHeight (thread-safe; snapshots survive regenerations)
+    glm::vec3 getTerrainNormal(float wx, float wz) const;
+    const HeightQuery& heightQuery() const;
+
+    // Batched heights (and optional normals) for many points in
+    // structure-of-arrays form; vectorized and spread over the job pool.
+    void getTerrainHeights(const float* xs, const float* zs, size_t count, float* heights,
+                           float* nx = nullptr, float* ny = nullptr, float* nz = nullptr) const;
+
+    // First hit of a ray with the drawn terrain (min/max pyramid traversal,
+    // exact per triangle), and the same for a window-space cursor position
+    // through the last drawn frame's camera.
+    bool raycastTerrain(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, RayHit &hit) const;
+    bool pickTerrain(double sx, double sy, RayHit &hit) const;
+
+    // Batched terrain line-of-sight for agents: bit i of visibleBits
+    // ((count + 63) / 64 words) is set when from[i] can see to[i].
+    void checkLineOfSight(const glm::vec3* from, const glm::vec3* to, size_t count, uint64_t* visibleBits) const;
+
+    // Slope-aware paths over the drawn terrain (waypoints at grid samples;
+    // false / empty when unreachable, or before the first navigation graph
+    // has been built). The batch form serves many requests concurrently on
+    // the job pool. Thread-safe.
+    bool findPath(const glm::vec3 &from, const glm::vec3 &to, std::vector<glm::vec3> &out);
+    void findPaths(const PathFinder::Request* requests, size_t count, std::vector<std::vector<glm::vec3>> &out);
+
     // Getters / setters for configurable constants and file paths
     int getTerrainSize() const;
     void setTerrainSize(int v);
@@ -121,6 +411,94 @@ public: // Public API
     void setHeightScale(float v);
     float getTextureTile() const;
     void setTextureTile(float v);
+    HeightLayout getHeightLayout() const;
+    void setHeightLayout(HeightLayout l);     // takes effect on regenerateTerrain()
+    HeightBackend getHeightBackend() const;
+    void setHeightBackend(HeightBackend b);   // takes effect on regenerateTerrain()
+    // Generate the current grid with both backends, print timings and return
+    // whether the largest absolute height difference is within tolerance.
+    // Only reads the GPU result back; the drawn terrain is left as it is.
+    bool compareHeightBackends(float tolerance = 1e-3f);
+    float getCpuGenMs() const;
+    float getGpuGenMs() const;
+    float getMaxBackendError() const;
+
+    // Simulation tick rate (Hz) and per-frame tick cap; movement and jump
+    // physics advance in fixed steps independent of the frame rate.
+    float getTickRate() const;
+    void setTickRate(float hz);
+    int getMaxSimSteps() const;
+    void setMaxSimSteps(int n);
+    uint64_t getDroppedSimTicks() const;
+
+    // Number of wandering agents simulated over the terrain (applied by the
+    // sim thread at its next tick), and the last agent update cost
+    int getAgentCount() const;
+    void setAgentCount(int n);
+    float getAgentUpdateMs() const;
+    float getBroadphaseMs() const;
+
+    // GL state calls issued and skipped as redundant during the last frame
+    uint32_t getGLCallsIssued() const;
+    uint32_t getGLCallsElided() const;
+
+    // Frame ordering. By default the sky is drawn after the terrain on the far
+    // plane (GL_LEQUAL), so early-Z skips the pixels the terrain covers; with
+    // setSkyLast(false) it is a full-screen fill drawn first. The optional
+    // depth prepass lays down terrain depth with a position-only program so
+    // the shaded pass runs once per visible pixel. The counters report the
+    // latest completed frame: fragments passing the depth test per pass and
+    // the GPU time of the whole scene (sum of the pass timers).
+    bool getSkyLast() const;
+    void setSkyLast(bool v);
+    bool getDepthPrepass() const;
+    void setDepthPrepass(bool v);
+    uint64_t getSkyFragments() const;
+    uint64_t getTerrainFragments() const;
+    float getSceneGpuMs() const;
+
+    // Dynamic resolution (off by default): the 3D scene renders into an
+    // offscreen target whose per-axis scale follows the GPU frame time
+    // against a budget (see DynamicResolution), and is upscaled to the
+    // backbuffer. The GUI is drawn afterwards at native resolution.
+    bool getDynamicResolution() const;
+    void setDynamicResolution(bool v);
+    float getResolutionTargetMs() const;
+    void setResolutionTargetMs(float ms);
+    float getResolutionScale() const;
+    int getSceneWidth() const;
+    int getSceneHeight() const;
+    const DynamicResolution& getDynamicResolutionController() const;
+
+    // Render graph of the last frame (pass order, culling, transient pool)
+    const RenderGraph& getRenderGraph() const;
+    // GPU time per render graph pass: latest, rolling average and
+    // percentiles over the last GpuPassTimer::WINDOW frames
+    const GpuPassTimer& getGpuPassTimer() const;
+
+    // Reproducible runs (call before mainloop). recordInput() logs every key
+    // and mouse event with the sim tick it was applied at; replayInput()
+    // restores the recorded start state and feeds the log back tick for
+    // tick instead of live input, closing the window when it runs out.
+    // setFrameTimingLog() writes frame, tick, frame time and camera position
+    // per rendered frame as CSV.
+    bool recordInput(const std::string &path);
+    bool replayInput(const std::string &path);
+    void setFrameTimingLog(const std::string &path);
+    bool isReplaying() const;
+
+    // CPU profile (core/profiler.h zones on every thread) as Chrome trace
+    // JSON. With a trace path set it is written when mainloop exits; F9
+    // writes it at any time (to nut_trace.json when no path is set).
+    void setTracePath(const std::string &path);
+    bool writeTrace();
+
+    TerrainRenderMode getTerrainRenderMode() const;
+    void setTerrainRenderMode(TerrainRenderMode m); // takes effect on regenerateTerrain()
+    size_t getLastUploadBytes() const;
+    float getLastUploadMs() const;
+    NormalMode getNormalMode() const;
+    void setNormalMode(NormalMode m);
 
     // File path accessors
     const std::string& getPanoramaPath() const;
@@ -128,6 +506,18 @@ public: // Public API
     const std::string& getTerrainTexturePath() const;
     void setTerrainTexturePath(const std::string &p);
 
+    // Load a 16-bit heightmap (binary PGM or headerless little-endian .raw;
+    // pass width/height for non-square .raw files). The data is converted once
+    // into a tiled mip pyramid (<path>.pyr) and paged in on demand, so files
+    // far larger than RAM work. Terrain then follows the camera.
+    bool loadHeightmap(const std::string &path, int64_t width = 0, int64_t height = 0);
+    void unloadHeightmap();
+    const std::string& getHeightmapPath() const;
+    size_t getTileBudgetMB() const;
+    void setTileBudgetMB(size_t mb);
+    int getDemLevel() const;
+    void setDemLevel(int level);
+
     // Cloud accessors
     bool getCloudEnabled() const;
     void setCloudEnabled(bool v);
@@ -142,10 +532,23 @@ public: // Public API
     std::string loadFile(const char* path);
     GLuint compileShaderFromFile(const char* path, GLenum type);
     GLuint createProgram(const char* vsPath, const char* fsPath);
+    void setupPrograms();
     float fbm(float x, float y);
     float getTerrainHeight(float wx, float wz);
     void buildTerrainMesh();
+    void buildTerrainFromHeights(Heightfield heights, float originX, float originZ, float spacing);
+    bool readDemWindow(double centerX, double centerZ, int level, float scale, float heightScale, Heightfield &heights,
+                       float &originX, float &originZ, float &spacing);
+    static void buildMeshArrays(const Heightfield &heights, float originX, float originZ, float spacing, float half, float textureTile,
+                                NormalMode normalMode, std::vector<float> &inter, std::vector<GLuint> &indices);
+    static std::shared_ptr<TerrainGrid> makeTerrainGrid(Heightfield heights, float originX, float originZ, float spacing);
+    void uploadTerrain(std::shared_ptr<TerrainGrid> grid, const std::vector<float> &inter, const std::vector<GLuint> &indices);
+    void dispatchGpuHeights(int N);
+    bool readGpuHeights(bool wait, Heightfield &heights);
+    bool pollGpuHeights(bool wait); // true when a readback was consumed
     void uploadMeshToGPU();
+    void createTerrainPatch();
+    void uploadHeightTexture(const Heightfield &heights);
     GLuint loadTexture(const char* path);
 
     // Input helpers
@@ -154,4 +557,12 @@ public: // Public API
     void cursorPosCallback(double xpos, double ypos);
     void keyCallback(int key, int scancode, int action, int mods);
     void updateMovement(float dt);
+
+    // Simulation thread
+    void startSimulation();
+    void stopSimulation();
+    void simLoop();
+    void applyInput(const InputEvent &e);
+    void syncAgents(const TerrainGrid &grid);
+    SimFrame makeSimFrame(Clock::time_point tickTime) const;
 };
@@ -0,0 +1,178 @@
+#include "bench_report.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace {
+void writeString(FILE* f, const std::string &s) {
+    std::fputc('"', f);
+    for (char c : s) {
+        if (c == '"' || c == '\\') std::fputc('\\', f);
+        if ((unsigned char)c >= 0x20) std::fputc(c, f);
+    }
+    std::fputc('"', f);
+}
+
+// Just enough JSON to read a report back: every number is stored under the
+// '/'-joined keys of the objects around it; strings, arrays and literals are
+// skipped
+struct Reader {
+    const char* p;
+    bool ok = true;
+
+    void ws() { while (std::isspace((unsigned char)*p)) ++p; }
+    bool expect(char c) { ws(); if (*p != c) return ok = false; ++p; return true; }
+    bool string(std::string &out) {
+        if (!expect('"')) return false;
+        out.clear();
+        for (; *p && *p != '"'; ++p) { if (*p == '\\' && p[1]) ++p; out += *p; }
+        return expect('"');
+    }
+    void value(const std::string &key, std::map<std::string, double> &out) {
+        ws();
+        if (*p == '{') {
+            ++p; ws();
+            if (*p == '}') { ++p; return; }
+            std::string name;
+            while (ok && string(name) && expect(':')) {
+                value(key.empty() ? name : key + "/" + name, out);
+                ws();
+                if (*p == ',') { ++p; continue; }
+                expect('}');
+                return;
+            }
+        } else if (*p == '[') {
+            ++p; ws();
+            if (*p == ']') { ++p; return; }
+            while (ok) {
+                value(key, out);
+                ws();
+                if (*p == ',') { ++p; continue; }
+                expect(']');
+                return;
+            }
+        } else if (*p == '"') {
+            std::string skip;
+            string(skip);
+        } else if (std::isalpha((unsigned char)*p)) {
+            while (std::isalpha((unsigned char)*p)) ++p;   // true / false / null
+        } else {
+            char* end = nullptr;
+            double v = std::strtod(p, &end);
+            if (end == p) { ok = false; return; }
+            out[key] = v;
+            p = end;
+        }
+    }
+};
+}
+
+void BenchReport::setInfo(const std::string &key, const std::string &value) {
+    for (auto &kv : info_) if (kv.first == key) { kv.second = value; return; }
+    info_.emplace_back(key, value);
+}
+
+BenchReport::Series& BenchReport::find(const std::string &group, const std::string &series) {
+    for (Series &s : series_) if (s.group == group && s.name == series) return s;
+    series_.push_back(Series{group, series, {}});
+    return series_.back();
+}
+
+void BenchReport::add(const std::string &group, const std::string &series, float ms) { find(group, series).ms.push_back(ms); }
+
+void BenchReport::add(const std::string &group, const std::string &series, const std::vector<float> &ms) {
+    std::vector<float> &dst = find(group, series).ms;
+    dst.insert(dst.end(), ms.begin(), ms.end());
+}
+
+bool BenchReport::summary(const std::string &group, const std::string &series, Summary &out) const {
+    for (const Series &s : series_) if (s.group == group && s.name == series) { out = summarize(s.ms); return true; }
+    return false;
+}
+
+BenchReport::Summary BenchReport::summarize(std::vector<float> ms) {
+    Summary s = {0.0, 0.0, 0.0, 0.0, 0.0, ms.size()};
+    if (ms.empty()) return s;
+    std::sort(ms.begin(), ms.end());
+    double sum = 0.0;
+    for (float v : ms) sum += v;
+    auto rank = [&](double q) { return ms[std::min(ms.size() - 1, (size_t)(q * ms.size()))]; };
+    s.mean = sum / ms.size();
+    s.p50 = rank(0.50); s.p95 = rank(0.95); s.p99 = rank(0.99);
+    s.max = ms.back();
+    return s;
+}
+
+bool BenchReport::write(const std::string &path) const {
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) { std::cerr << "Failed to write report " << path << std::endl; return false; }
+    std::fprintf(f, "{\n  \"info\": {");
+    for (size_t i = 0; i < info_.size(); ++i) {
+        std::fprintf(f, "%s\n    ", i ? "," : "");
+        writeString(f, info_[i].first);
+        std::fprintf(f, ": ");
+        writeString(f, info_[i].second);
+    }
+    std::fprintf(f, "\n  }");
+
+    std::vector<std::string> groups;
+    for (const Series &s : series_) if (std::find(groups.begin(), groups.end(), s.group) == groups.end()) groups.push_back(s.group);
+    for (const std::string &g : groups) {
+        std::fprintf(f, ",\n  ");
+        writeString(f, g);
+        std::fprintf(f, ": {");
+        bool first = true;
+        for (const Series &s : series_) {
+            if (s.group != g) continue;
+            Summary sm = summarize(s.ms);
+            std::fprintf(f, "%s\n    ", first ? "" : ",");
+            writeString(f, s.name);
+            std::fprintf(f, ": {\"samples\": %zu, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+                         sm.samples, sm.mean, sm.p50, sm.p95, sm.p99, sm.max);
+            first = false;
+        }
+        std::fprintf(f, "\n  }");
+    }
+    std::fprintf(f, "\n}\n");
+    bool ok = std::ferror(f) == 0;
+    std::fclose(f);
+    return ok;
+}
+
+bool BenchReport::compare(const std::string &baselinePath, double thresholdPct) const {
+    std::ifstream in(baselinePath);
+    if (!in) { std::cerr << "Failed to open baseline " << baselinePath << std::endl; return false; }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string text = ss.str();
+    std::map<std::string, double> base;
+    Reader reader{text.c_str()};
+    reader.value("", base);
+    if (!reader.ok) { std::cerr << "Malformed baseline " << baselinePath << std::endl; return false; }
+
+    int regressions = 0, compared = 0;
+    for (const Series &s : series_) {
+        Summary now = summarize(s.ms);
+        const char* metrics[2] = {"mean", "p95"};
+        const double values[2] = {now.mean, now.p95};
+        for (int m = 0; m < 2; ++m) {
+            auto it = base.find(s.group + "/" + s.name + "/" + metrics[m]);
+            if (it == base.end()) continue;
+            ++compared;
+            double was = it->second, delta = values[m] - was;
+            if (delta > MIN_DELTA_MS && delta > was * thresholdPct * 0.01) {
+                std::printf("REGRESSION %s/%s %s: %.3f -> %.3f ms (%+.1f%%)\n", s.group.c_str(), s.name.c_str(), metrics[m], was, values[m],
+                            was > 0.0 ? delta * 100.0 / was : 100.0);
+                ++regressions;
+            }
+        }
+    }
+    std::printf("baseline %s: %d values compared, %d regressions over %.1f%%\n", baselinePath.c_str(), compared, regressions, thresholdPct);
+    return regressions == 0;
+}
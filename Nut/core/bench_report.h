@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Timing report of a scripted run. Samples (ms) go into named series inside
+// groups ("frame", "cpu", "gpu"). write() emits JSON with the mean and the
+// nearest-rank p50/p95/p99/max of every series, plus free-form info strings.
+// compare() checks the run against a report written earlier.
+class BenchReport {
+public:
+    struct Summary {
+        double mean, p50, p95, p99, max;
+        size_t samples;
+    };
+
+    // A regression must also be at least this large in absolute terms, so
+    // sub-0.1 ms zones don't fail the comparison on timer noise
+    static constexpr double MIN_DELTA_MS = 0.1;
+
+    void setInfo(const std::string &key, const std::string &value);
+    void add(const std::string &group, const std::string &series, float ms);
+    void add(const std::string &group, const std::string &series, const std::vector<float> &ms);
+    bool summary(const std::string &group, const std::string &series, Summary &out) const;
+    static Summary summarize(std::vector<float> ms);
+
+    bool write(const std::string &path) const;
+
+    // Print every series present in both reports whose mean or p95 grew by
+    // more than thresholdPct percent (and MIN_DELTA_MS); false if any did or
+    // the baseline can't be read
+    bool compare(const std::string &baselinePath, double thresholdPct) const;
+
+private:
+    struct Series {
+        std::string group, name;
+        std::vector<float> ms;
+    };
+    Series& find(const std::string &group, const std::string &series);
+
+    std::vector<std::pair<std::string, std::string>> info_;
+    std::vector<Series> series_;       // groups are written in first-seen order
+};
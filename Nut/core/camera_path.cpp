@@ -0,0 +1,72 @@
+#include "camera_path.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+template <typename T>
+T catmullRom(const T &p0, const T &p1, const T &p2, const T &p3, float t) {
+    float t2 = t * t, t3 = t2 * t;
+    return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+}
+
+bool CameraPath::load(const std::string &path) {
+    std::ifstream in(path);
+    if (!in) { std::cerr << "Failed to open camera path " << path << std::endl; return false; }
+    keys_.clear(); closed_ = false;
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+        ++lineNo;
+        line = line.substr(0, line.find('#'));
+        std::istringstream ss(line);
+        std::string first;
+        if (!(ss >> first)) continue;
+        if (first == "closed") { closed_ = true; continue; }
+        CameraKey k;
+        std::istringstream all(line);
+        if (!(all >> k.pos.x >> k.pos.y >> k.pos.z >> k.yaw >> k.pitch)) {
+            std::cerr << path << ":" << lineNo << ": expected \"x y z yaw pitch\"" << std::endl; return false;
+        }
+        keys_.push_back(k);
+    }
+    if (keys_.empty()) { std::cerr << "Camera path " << path << " has no keys" << std::endl; return false; }
+    return true;
+}
+
+// Neighbour keys for the spline ends: wrap when closed, clamp otherwise
+const CameraKey& CameraPath::key(int i) const {
+    int n = (int)keys_.size();
+    if (closed_) return keys_[((i % n) + n) % n];
+    return keys_[std::min(std::max(i, 0), n - 1)];
+}
+
+// Yaw of key i; on a closed path that turned whole circles between its
+// first and last key, each lap past the end adds those turns so the spline
+// keeps turning instead of spinning back
+float CameraPath::yaw(int i) const {
+    if (!closed_) return key(i).yaw;
+    int n = (int)keys_.size();
+    float turns = std::round((keys_.back().yaw - keys_.front().yaw) / 360.0f);
+    int lap = i >= 0 ? i / n : -((n - 1 - i) / n);
+    return key(i).yaw + lap * turns * 360.0f;
+}
+
+CameraKey CameraPath::sample(float t) const {
+    if (keys_.empty()) return CameraKey{glm::vec3(0.0f), 0.0f, 0.0f};
+    if (keys_.size() == 1) return keys_[0];
+    int segments = (int)keys_.size() - (closed_ ? 0 : 1);
+    float s = std::min(std::max(t, 0.0f), 1.0f) * segments;
+    int i = std::min((int)s, segments - 1);
+    float f = s - i;
+    const CameraKey &k0 = key(i - 1), &k1 = key(i), &k2 = key(i + 1), &k3 = key(i + 2);
+    CameraKey out;
+    out.pos = catmullRom(k0.pos, k1.pos, k2.pos, k3.pos, f);
+    out.yaw = catmullRom(yaw(i - 1), yaw(i), yaw(i + 1), yaw(i + 2), f);
+    out.pitch = catmullRom(k0.pitch, k1.pitch, k2.pitch, k3.pitch, f);
+    return out;
+}
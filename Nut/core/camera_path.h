@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Camera pose at one point of a scripted path; yaw / pitch in degrees, as
+// in Engine (yaw is not wrapped, so keys can turn past 360)
+struct CameraKey {
+    glm::vec3 pos;
+    float yaw, pitch;
+};
+
+// Uniform Catmull-Rom spline through camera keys, evaluated by a parameter
+// t in [0, 1] over the whole path (keys evenly spaced in t). A closed path
+// runs from the first key back to it.
+class CameraPath {
+public:
+    void add(const CameraKey &key) { keys_.push_back(key); }
+    void clear() { keys_.clear(); }
+    void setClosed(bool closed) { closed_ = closed; }
+    bool closed() const { return closed_; }
+    size_t size() const { return keys_.size(); }
+    bool empty() const { return keys_.empty(); }
+
+    // Text file, one key per line: "x y z yaw pitch"; '#' starts a comment,
+    // a line reading "closed" closes the path
+    bool load(const std::string &path);
+
+    CameraKey sample(float t) const;
+
+private:
+    const CameraKey& key(int i) const;
+    float yaw(int i) const;
+    std::vector<CameraKey> keys_;
+    bool closed_ = false;
+};
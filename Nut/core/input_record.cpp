@@ -0,0 +1,84 @@
+#include "input_record.h"
+
+#include <cstring>
+
+static const char MAGIC[8] = {'N', 'U', 'T', 'R', 'E', 'C', '1', 0};
+enum : uint8_t { REC_KEY = 0, REC_LOOK = 1, REC_END = 2, REC_RATE = 3 };
+
+bool InputRecorder::open(const std::string &path, const InputRecordHeader &header) {
+    close(0);
+    f_ = std::fopen(path.c_str(), "wb");
+    if (!f_) return false;
+    std::fwrite(MAGIC, 1, sizeof(MAGIC), f_);
+    std::fwrite(&header, sizeof(header), 1, f_);
+    return true;
+}
+
+void InputRecorder::write(uint64_t tick, const InputEvent &e) {
+    if (!f_) return;
+    uint32_t t = (uint32_t)tick;
+    std::fwrite(&t, 4, 1, f_);
+    if (e.type == InputEvent::Key) {
+        uint8_t type = REC_KEY, action = (uint8_t)e.action; int16_t key = (int16_t)e.key;
+        std::fwrite(&type, 1, 1, f_); std::fwrite(&key, 2, 1, f_); std::fwrite(&action, 1, 1, f_);
+    } else if (e.type == InputEvent::Look) {
+        uint8_t type = REC_LOOK;
+        std::fwrite(&type, 1, 1, f_); std::fwrite(&e.dx, 4, 1, f_); std::fwrite(&e.dy, 4, 1, f_);
+    } else {
+        uint8_t type = REC_RATE;
+        std::fwrite(&type, 1, 1, f_); std::fwrite(&e.hz, 4, 1, f_);
+    }
+}
+
+void InputRecorder::close(uint64_t endTick) {
+    if (!f_) return;
+    uint32_t t = (uint32_t)endTick; uint8_t type = REC_END;
+    std::fwrite(&t, 4, 1, f_); std::fwrite(&type, 1, 1, f_);
+    std::fclose(f_); f_ = nullptr;
+}
+
+bool InputReplay::open(const std::string &path) {
+    close();
+    f_ = std::fopen(path.c_str(), "rb");
+    if (!f_) return false;
+    char magic[8];
+    if (std::fread(magic, 1, 8, f_) != 8 || std::memcmp(magic, MAGIC, 8) != 0 || std::fread(&header_, sizeof(header_), 1, f_) != 1) { close(); return false; }
+    pending_ = ended_ = false; lastTick_ = 0;
+    return true;
+}
+
+void InputReplay::close() {
+    if (f_) std::fclose(f_);
+    f_ = nullptr;
+}
+
+bool InputReplay::readRecord() {
+    // Without an End record (EOF or a torn last record) the log ends at the
+    // last complete event
+    uint32_t t; uint8_t type;
+    if (!f_ || std::fread(&t, 4, 1, f_) != 1 || std::fread(&type, 1, 1, f_) != 1) { ended_ = true; endTick_ = lastTick_; return false; }
+    if (type == REC_END) { ended_ = true; endTick_ = t; return false; }
+    InputEvent e{};
+    bool ok;
+    if (type == REC_KEY) {
+        int16_t key = 0; uint8_t action = 0;
+        ok = std::fread(&key, 2, 1, f_) == 1 && std::fread(&action, 1, 1, f_) == 1;
+        e.type = InputEvent::Key; e.key = key; e.action = action;
+    } else if (type == REC_LOOK) {
+        ok = std::fread(&e.dx, 4, 1, f_) == 1 && std::fread(&e.dy, 4, 1, f_) == 1;
+        e.type = InputEvent::Look;
+    } else {
+        ok = type == REC_RATE && std::fread(&e.hz, 4, 1, f_) == 1;
+        e.type = InputEvent::TickRate;
+    }
+    if (!ok) { ended_ = true; endTick_ = lastTick_; return false; }
+    pending_ = true; pendingTick_ = lastTick_ = t; pendingEvent_ = e;
+    return true;
+}
+
+bool InputReplay::next(uint64_t tick, InputEvent &e) {
+    if (!pending_ && (ended_ || !readRecord())) return false;
+    if (pendingTick_ > tick) return false;
+    e = pendingEvent_; pending_ = false;
+    return true;
+}
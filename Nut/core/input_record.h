@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Window input forwarded from the GLFW callbacks to the simulation thread;
+// TickRate events only come from input logs
+struct InputEvent {
+    enum Type : uint8_t { Key, Look, TickRate } type;
+    int key, action;             // Key
+    float dx, dy;                // Look: yaw / pitch deltas in degrees
+    float hz;                    // TickRate: sim rate from this tick on
+};
+
+// Simulation state a recording starts from
+struct InputRecordHeader {
+    float tickRate;
+    float camX, camY, camZ, yaw, pitch;
+};
+
+// Binary input log: "NUTREC1\0", the header, then one record per event
+// tagged with the sim tick it was applied before, ended by an End record
+// holding the total tick count. Key records take 8 bytes, Look records 13,
+// TickRate records 9.
+class InputRecorder {
+public:
+    // Not closed through close(): leave out the End record so the log ends
+    // at its last event rather than at tick 0
+    ~InputRecorder() { if (f_) std::fclose(f_); }
+    bool open(const std::string &path, const InputRecordHeader &header);
+    bool isOpen() const { return f_ != nullptr; }
+    void write(uint64_t tick, const InputEvent &e);
+    void close(uint64_t endTick);
+
+private:
+    FILE* f_ = nullptr;
+};
+
+// Reads a recording back; events come out in the order they were written.
+class InputReplay {
+public:
+    ~InputReplay() { close(); }
+    bool open(const std::string &path);
+    bool isOpen() const { return f_ != nullptr; }
+    void close();
+    const InputRecordHeader& header() const { return header_; }
+
+    // Next event due before tick `tick`; false when none is left for it
+    bool next(uint64_t tick, InputEvent &e);
+    // True once `tick` reaches the recorded length; a log cut off before its
+    // End record (crashed or killed run) ends at its last event's tick
+    bool finished(uint64_t tick) const { return ended_ && tick >= endTick_; }
+
+private:
+    bool readRecord();
+
+    FILE* f_ = nullptr;
+    InputRecordHeader header_{};
+    bool pending_ = false, ended_ = false;
+    uint64_t pendingTick_ = 0, endTick_ = 0, lastTick_ = 0;
+    InputEvent pendingEvent_{};
+};
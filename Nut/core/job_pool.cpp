@@ -0,0 +1,87 @@
+#include "job_pool.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+
+JobPool::JobPool(unsigned workers) : stop_(false) {
+    if (workers == 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        workers = hw > 1 ? hw - 1 : 0;
+    }
+    for (unsigned i = 0; i < workers; ++i) workers_.emplace_back([this] { workerLoop(); });
+}
+
+JobPool::~JobPool() {
+    { std::lock_guard<std::mutex> lock(mutex_); stop_ = true; }
+    cv_.notify_all();
+    for (auto &t : workers_) t.join();
+}
+
+JobPool& JobPool::instance() {
+    static JobPool pool;
+    return pool;
+}
+
+void JobPool::workerLoop() {
+    PROFILE_THREAD("job worker");
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stop_ || !queue_.empty() || !background_.empty(); });
+            if (stop_ && queue_.empty() && background_.empty()) return;
+            std::deque<std::function<void()>> &q = queue_.empty() ? background_ : queue_;
+            job = std::move(q.front()); q.pop_front();
+        }
+        PROFILE_ZONE("job");
+        job();
+    }
+}
+
+void JobPool::submit(std::function<void()> fn) {
+    if (workers_.empty()) { fn(); return; }
+    { std::lock_guard<std::mutex> lock(mutex_); background_.push_back(std::move(fn)); }
+    cv_.notify_one();
+}
+
+bool JobPool::runOne() {
+    std::function<void()> job;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty()) return false;
+        job = std::move(queue_.front()); queue_.pop_front();
+    }
+    PROFILE_ZONE("job");
+    job();
+    return true;
+}
+
+void JobPool::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+    if (end <= begin) return;
+    size_t count = end - begin;
+    if (grain == 0) grain = 1;
+
+    // Aim for a few chunks per thread so uneven rows still balance out
+    size_t maxChunks = (size_t)concurrency() * 4;
+    size_t chunks = std::min(maxChunks, (count + grain - 1) / grain);
+    if (chunks <= 1 || workers_.empty()) { fn(begin, end); return; }
+    size_t step = (count + chunks - 1) / chunks;
+
+    std::atomic<size_t> remaining(chunks);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t c = 1; c < chunks; ++c) {
+            size_t b = begin + c * step; size_t e = std::min(end, b + step);
+            queue_.emplace_back([&fn, &remaining, b, e] { if (b < e) fn(b, e); remaining.fetch_sub(1, std::memory_order_acq_rel); });
+        }
+    }
+    cv_.notify_all();
+
+    // First chunk runs on the caller, then help drain the queue until done
+    fn(begin, std::min(end, begin + step));
+    remaining.fetch_sub(1, std::memory_order_acq_rel);
+    while (remaining.load(std::memory_order_acquire) != 0) {
+        if (!runOne()) std::this_thread::yield();
+    }
+}
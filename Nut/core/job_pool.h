@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed-size worker pool shared by the CPU-heavy engine passes
+// (terrain normals, batched queries, ...). A single process-wide instance
+// is available through instance(); its size follows hardware_concurrency.
+class JobPool {
+public:
+    // workers == 0 picks hardware_concurrency() - 1 (the caller also works).
+    explicit JobPool(unsigned workers = 0);
+    ~JobPool();
+
+    JobPool(const JobPool&) = delete;
+    JobPool& operator=(const JobPool&) = delete;
+
+    // Shared pool used by the engine.
+    static JobPool& instance();
+
+    // Number of threads that execute work, including the calling thread.
+    unsigned concurrency() const { return (unsigned)workers_.size() + 1; }
+
+    // Split [begin, end) into chunks of at least `grain` items and run
+    // fn(chunkBegin, chunkEnd) across the pool. Blocks until every chunk is
+    // done; the calling thread runs chunks too, so nesting is safe.
+    void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+    // Queue a long job (terrain window builds, ...) and return at once. Only
+    // workers run these, after any parallelFor chunks, so a thread helping
+    // in parallelFor never gets stuck in one. Without workers fn runs inline.
+    void submit(std::function<void()> fn);
+
+private:
+    void workerLoop();
+    bool runOne(); // pop and run one queued job; false if the queue was empty
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> queue_;
+    std::deque<std::function<void()>> background_; // submit()ted jobs
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+};
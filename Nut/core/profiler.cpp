@@ -0,0 +1,150 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+using Profiler::Event;
+
+// One per thread that ever recorded; kept until exit so a finished thread's
+// events still reach the trace
+struct ThreadRing : Profiler::Ring {
+    std::unique_ptr<Event[]> storage{new Event[Profiler::RING_EVENTS]};
+    std::string name;
+    int tid = 0;
+    static const int STACK = 64;
+    const char* stackName[STACK];
+    uint64_t stackStart[STACK];
+    int depth = 0;
+    ThreadRing() { events = storage.get(); }
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    // Tick -> wall clock mapping, sampled at start-up and again at export
+    uint64_t tick0 = Profiler::ticks();
+    std::chrono::steady_clock::time_point wall0 = std::chrono::steady_clock::now();
+};
+
+Registry& registry() { static Registry r; return r; }
+
+ThreadRing* localRing() { return static_cast<ThreadRing*>(Profiler::threadRing()); }
+
+// Tick length from the span since start-up
+double usPerTick(const Registry &r) {
+    uint64_t tick1 = Profiler::ticks();
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - r.wall0).count();
+    return us > 0.0 && tick1 > r.tick0 ? us / (double)(tick1 - r.tick0) : 1e-3;
+}
+
+void writeEscaped(FILE* f, const char* s) {
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') std::fputc('\\', f);
+        if ((unsigned char)*s >= 0x20) std::fputc(*s, f);
+    }
+}
+}
+
+Profiler::Ring* Profiler::createThreadRing() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.rings.emplace_back(new ThreadRing());
+    ThreadRing* ring = r.rings.back().get();
+    ring->tid = (int)r.rings.size();
+    ring->name = "thread " + std::to_string(ring->tid);
+    threadRingPtr = ring;
+    return ring;
+}
+
+void Profiler::beginZone(const char* name) {
+    ThreadRing* ring = localRing();
+    if (ring->depth < ThreadRing::STACK) { ring->stackName[ring->depth] = name; ring->stackStart[ring->depth] = ticks(); }
+    ++ring->depth;
+}
+
+void Profiler::endZone() {
+    uint64_t now = ticks();
+    ThreadRing* ring = localRing();
+    if (ring->depth == 0) return;
+    --ring->depth;
+    if (ring->depth < ThreadRing::STACK) record(ring, ring->stackName[ring->depth], ring->stackStart[ring->depth], now);
+}
+
+void Profiler::setThreadName(const char* name) {
+    ThreadRing* ring = localRing();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    ring->name = name;
+}
+
+size_t Profiler::threadCount() {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    return registry().rings.size();
+}
+
+bool Profiler::writeChromeTrace(const std::string &path) {
+    Registry &r = registry();
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) { std::cerr << "Failed to write trace " << path << std::endl; return false; }
+
+    double tickUs = usPerTick(r);
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    std::vector<Event> copy;
+    for (const std::unique_ptr<ThreadRing> &ring : r.rings) {
+        std::fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", first ? "" : ",\n", ring->tid);
+        writeEscaped(f, ring->name.c_str());
+        std::fprintf(f, "\"}}");
+        first = false;
+
+        // Copy the live part of the ring, then drop whatever the owner may
+        // have overwritten while we copied: events up to `after` are done,
+        // and event `after` may be mid-write into the slot of after + 1 - RING_EVENTS.
+        // The copy itself is a plain read racing the owner's plain writes;
+        // torn events are discarded here, but TSan still reports the race.
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = head > RING_EVENTS ? head - RING_EVENTS : 0;
+        copy.clear();
+        for (uint64_t i = begin; i < head; ++i) copy.push_back(ring->events[i & (RING_EVENTS - 1)]);
+        std::atomic_thread_fence(std::memory_order_acquire);   // copy reads before re-reading head
+        uint64_t after = ring->head.load(std::memory_order_relaxed);
+        uint64_t safe = after + 1 > RING_EVENTS ? after + 1 - RING_EVENTS : 0;
+        for (uint64_t i = std::max(begin, safe); i < head; ++i) {
+            const Event &e = copy[i - begin];
+            if (e.end < r.tick0) continue;
+            double ts = (double)(e.start > r.tick0 ? e.start - r.tick0 : 0) * tickUs;
+            double dur = (double)(e.end - std::max(e.start, r.tick0)) * tickUs;
+            std::fprintf(f, ",\n{\"name\":\"");
+            writeEscaped(f, e.name);
+            std::fprintf(f, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", ring->tid, ts, dur);
+        }
+    }
+    std::fprintf(f, "\n]}\n");
+    bool ok = std::ferror(f) == 0;
+    std::fclose(f);
+    return ok;
+}
+
+std::vector<Profiler::ZoneTimes> Profiler::zoneTimes(uint64_t since) {
+    ThreadRing* ring = localRing();
+    double msPerTick = usPerTick(registry()) * 1e-3;
+    std::vector<ZoneTimes> out;
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    for (uint64_t i = head > RING_EVENTS ? head - RING_EVENTS : 0; i < head; ++i) {
+        const Event &e = ring->events[i & (RING_EVENTS - 1)];
+        if (e.start < since) continue;
+        // Names may be equal strings at different addresses
+        auto it = std::find_if(out.begin(), out.end(), [&](const ZoneTimes &z) { return z.name == e.name || std::strcmp(z.name, e.name) == 0; });
+        if (it == out.end()) { out.push_back(ZoneTimes{e.name, {}}); it = out.end() - 1; }
+        it->ms.push_back((float)((double)(e.end - e.start) * msPerTick));
+    }
+    return out;
+}
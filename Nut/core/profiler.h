@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Compile-time switch: build with -DNUT_PROFILE=0 and every zone macro
+// expands to nothing
+#ifndef NUT_PROFILE
+#define NUT_PROFILE 1
+#endif
+
+// Scoped CPU zones. A zone records one complete event (name, start, end)
+// into a ring buffer owned by the calling thread: no locks, and no
+// allocation after the thread's first zone. Nesting follows from the
+// timestamps. When a ring wraps the oldest events are overwritten.
+// writeChromeTrace() merges every thread's ring into Chrome trace-event
+// JSON (chrome://tracing, ui.perfetto.dev). Zone names must outlive the
+// profiler (string literals, __func__).
+namespace Profiler {
+    static const size_t RING_EVENTS = 1 << 16;   // per thread
+
+    // Timestamp in profiler ticks (TSC on x86, steady_clock ns elsewhere)
+    inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    // One thread's event ring; only the owning thread writes it
+    struct Event { const char* name; uint64_t start, end; };
+    struct Ring {
+        Event* events;
+        std::atomic<uint64_t> head{0};  // events ever written
+    };
+
+    // The calling thread's ring, registered on its first zone
+    Ring* createThreadRing();
+    inline thread_local Ring* threadRingPtr = nullptr;
+    inline Ring* threadRing() { Ring* ring = threadRingPtr; return ring ? ring : createThreadRing(); }
+
+    inline void record(Ring* ring, const char* name, uint64_t start, uint64_t end) {
+        uint64_t h = ring->head.load(std::memory_order_relaxed);
+        ring->events[h & (RING_EVENTS - 1)] = Event{name, start, end};
+        ring->head.store(h + 1, std::memory_order_release);
+    }
+    inline void record(const char* name, uint64_t start, uint64_t end) { record(threadRing(), name, start, end); }
+    // Unscoped zones for callback pairs (render graph pass hooks); a small
+    // per-thread stack matches them, so they must nest properly
+    void beginZone(const char* name);
+    void endZone();
+    // Label for the calling thread in the trace
+    void setThreadName(const char* name);
+
+    // Snapshot of every thread's events while other threads keep recording.
+    // Events overwritten during the copy are dropped, but the copy is an
+    // unsynchronised read of the rings, so TSan flags it.
+    bool writeChromeTrace(const std::string &path);
+    size_t threadCount();
+
+    // Durations (ms) of the calling thread's zones that started at or after
+    // tick `since`, grouped by name in first-seen order. Only what the ring
+    // still holds is included.
+    struct ZoneTimes { const char* name; std::vector<float> ms; };
+    std::vector<ZoneTimes> zoneTimes(uint64_t since);
+}
+
+// Looks up the thread's ring once, before the start timestamp, so the
+// destructor is a plain store into it
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : ring_(Profiler::threadRing()), name_(name), start_(Profiler::ticks()) {}
+    ~ProfileZone() { Profiler::record(ring_, name_, start_, Profiler::ticks()); }
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+private:
+    Profiler::Ring* ring_;
+    const char* name_;
+    uint64_t start_;
+};
+
+#if NUT_PROFILE
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#define PROFILE_THREAD(name) Profiler::setThreadName(name)
+#define PROFILE_BEGIN(name) Profiler::beginZone(name)
+#define PROFILE_END() Profiler::endZone()
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END() ((void)0)
+#endif
@@ -0,0 +1,22 @@
+#include "sim_clock.h"
+
+#include <algorithm>
+#include <cmath>
+
+SimClock::SimClock(double tickRate, int maxSteps) : step_(1.0 / 60.0), accumulator_(0.0), maxSteps_(1), ticks_(0), dropped_(0) {
+    setTickRate(tickRate); setMaxSteps(maxSteps);
+}
+
+void SimClock::setTickRate(double hz) {
+    step_ = 1.0 / std::min(std::max(hz, 1.0), 1000.0);
+    accumulator_ = std::fmod(accumulator_, step_);
+}
+
+int SimClock::advance(double frameSeconds) {
+    accumulator_ += std::max(frameSeconds, 0.0);
+    int steps = (int)(accumulator_ / step_);
+    accumulator_ -= steps * step_;
+    if (steps > maxSteps_) { dropped_ += steps - maxSteps_; steps = maxSteps_; } // spiral-of-death guard
+    ticks_ += steps;
+    return steps;
+}
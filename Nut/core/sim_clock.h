@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+// Fixed-timestep simulation clock. Frame time goes into an accumulator that
+// is drained in whole ticks of 1 / tickRate seconds; what is left over is
+// the interpolation factor for rendering between the last two sim states.
+class SimClock {
+public:
+    explicit SimClock(double tickRate = 60.0, int maxSteps = 8);
+
+    void setTickRate(double hz);       // clamped to [1, 1000]
+    double tickRate() const { return 1.0 / step_; }
+    double step() const { return step_; }
+
+    // Upper bound on ticks per advance(); backlog beyond it is dropped
+    // so a slow frame cannot snowball into ever longer frames.
+    void setMaxSteps(int n) { maxSteps_ = n < 1 ? 1 : n; }
+    int maxSteps() const { return maxSteps_; }
+
+    // Feed frameSeconds of wall time; returns the number of ticks to run now.
+    int advance(double frameSeconds);
+
+    // Fraction of a tick left in the accumulator, in [0, 1)
+    float alpha() const { return (float)(accumulator_ / step_); }
+
+    uint64_t ticks() const { return ticks_; }
+    uint64_t droppedTicks() const { return dropped_; }
+
+private:
+    double step_;
+    double accumulator_;
+    int maxSteps_;
+    uint64_t ticks_, dropped_;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded single-producer / single-consumer ring. push() and pop() are
+// wait-free: each is a couple of atomic loads and one store, never a lock
+// or a retry loop. Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+public:
+    SpscQueue() : head_(0), tail_(0) {}
+
+    // Producer; false when the ring is full (the item is dropped)
+    bool push(const T& v) {
+        size_t h = head_.load(std::memory_order_relaxed);
+        if (h - tail_.load(std::memory_order_acquire) == Capacity) return false;
+        buf_[h & (Capacity - 1)] = v;
+        head_.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer; false when empty
+    bool pop(T& out) {
+        size_t t = tail_.load(std::memory_order_relaxed);
+        if (t == head_.load(std::memory_order_acquire)) return false;
+        out = buf_[t & (Capacity - 1)];
+        tail_.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T buf_[Capacity];
+    alignas(64) std::atomic<size_t> head_; // written by the producer
+    alignas(64) std::atomic<size_t> tail_; // written by the consumer
+};
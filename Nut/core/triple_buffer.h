@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free triple buffer for handing the latest state from one producer
+// thread to one consumer thread. The writer fills back() and publish()es it;
+// the reader calls update() and reads front(). Neither side ever waits: the
+// writer overwrites a frame the reader skipped, and the reader keeps the
+// previous frame until a new one is published.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : back_(0), front_(1), middle_(2) {}
+
+    // Writer side
+    T& back() { return slots_[back_]; }
+    void publish() { back_ = middle_.exchange(back_ | DIRTY, std::memory_order_acq_rel) & INDEX; }
+
+    // Reader side; returns true if front() changed
+    bool update() {
+        if (!(middle_.load(std::memory_order_relaxed) & DIRTY)) return false;
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    const T& front() const { return slots_[front_]; }
+
+    // Seed all three slots before the threads start
+    void reset(const T& v) { slots_[0] = slots_[1] = slots_[2] = v; }
+
+private:
+    static constexpr unsigned INDEX = 3, DIRTY = 4;
+
+    T slots_[3];
+    alignas(64) unsigned back_;              // writer-owned
+    alignas(64) unsigned front_;             // reader-owned
+    alignas(64) std::atomic<unsigned> middle_; // shared slot index | DIRTY
+};
@@ -9,6 +9,7 @@
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 GUI::GUI(Engine* engine) : engine_(engine), window_(nullptr), initialized_(false) {}
 
@@ -79,6 +80,19 @@ void GUI::render() {
 
     ImGui::Separator();
 
+    // DEM heightmap (16-bit PGM / raw)
+    static char hbuf[512] = "";
+    ImGui::InputText("Heightmap Path", hbuf, sizeof(hbuf));
+    if (ImGui::Button("Load Heightmap")) engine_->loadHeightmap(std::string(hbuf));
+    ImGui::SameLine();
+    if (ImGui::Button("Use Procedural")) engine_->unloadHeightmap();
+    int budget = (int)engine_->getTileBudgetMB();
+    if (ImGui::InputInt("Tile Budget (MB)", &budget)) engine_->setTileBudgetMB((size_t)std::max(budget, 1));
+    int lvl = engine_->getDemLevel();
+    if (ImGui::InputInt("DEM Mip Level", &lvl)) engine_->setDemLevel(lvl);
+
+    ImGui::Separator();
+
     // Constants
     int ts = engine_->getTerrainSize();
     if (ImGui::InputInt("Terrain Size", &ts)) {
@@ -91,6 +105,13 @@ void GUI::render() {
     if (ImGui::InputFloat("Height Scale", &hs)) engine_->setHeightScale(hs);
     float tt = engine_->getTextureTile();
     if (ImGui::InputFloat("Texture Tile", &tt)) engine_->setTextureTile(tt);
+    const char* renderModes[] = { "Mesh (VBO)", "Height Texture" };
+    int rm = (int)engine_->getTerrainRenderMode();
+    if (ImGui::Combo("Terrain Mode", &rm, renderModes, 2)) { engine_->setTerrainRenderMode((TerrainRenderMode)rm); engine_->regenerateTerrain(); }
+    ImGui::Text("Last upload: %.2f MB in %.2f ms", engine_->getLastUploadBytes() / 1048576.0, engine_->getLastUploadMs());
+    const char* normalModes[] = { "Accumulate (faces)", "Stencil (SIMD)" };
+    int nm = (int)engine_->getNormalMode();
+    if (ImGui::Combo("Normals", &nm, normalModes, 2)) engine_->setNormalMode((NormalMode)nm);
 
     // Cloud controls
     bool ce = engine_->getCloudEnabled();
@@ -102,12 +123,60 @@ void GUI::render() {
     float cop = engine_->getCloudOpacity();
     if (ImGui::SliderFloat("Cloud Opacity", &cop, 0.0f, 1.0f)) engine_->setCloudOpacity(cop);
 
+    const char* layouts[] = { "Row-major", "Tiled 8x8" };
+    int hl = (int)engine_->getHeightLayout();
+    if (ImGui::Combo("Height Layout", &hl, layouts, 2)) engine_->setHeightLayout((HeightLayout)hl);
+    const char* backends[] = { "CPU fbm", "GPU fbm (readback)" };
+    int hb = (int)engine_->getHeightBackend();
+    if (ImGui::Combo("Height Backend", &hb, backends, 2)) engine_->setHeightBackend((HeightBackend)hb);
+    if (ImGui::Button("Compare CPU/GPU Heights")) engine_->compareHeightBackends(1e-3f * engine_->getHeightScale());
+    ImGui::Text("CPU %.2f ms | GPU %.2f ms | max diff %.5f", engine_->getCpuGenMs(), engine_->getGpuGenMs(), engine_->getMaxBackendError());
+
+    // Simulation clock
+    float tr = engine_->getTickRate();
+    if (ImGui::SliderFloat("Tick Rate (Hz)", &tr, 10.0f, 240.0f)) engine_->setTickRate(tr);
+    int ms = engine_->getMaxSimSteps();
+    if (ImGui::SliderInt("Max Sim Steps", &ms, 1, 32)) engine_->setMaxSimSteps(ms);
+    ImGui::Text("Dropped ticks: %llu | input latency %.2f ms", (unsigned long long)engine_->getDroppedSimTicks(), engine_->getInputLatencyMs());
+    int agents = engine_->getAgentCount();
+    if (ImGui::SliderInt("Agents", &agents, 0, 200000)) engine_->setAgentCount(agents);
+    ImGui::Text("Agent update: %.3f ms | broadphase: %.3f ms", engine_->getAgentUpdateMs(), engine_->getBroadphaseMs());
+    ImGui::Text("GL state calls: %u issued, %u elided", engine_->getGLCallsIssued(), engine_->getGLCallsElided());
+    bool skyLast = engine_->getSkyLast();
+    if (ImGui::Checkbox("Sky Last (early-Z)", &skyLast)) engine_->setSkyLast(skyLast);
+    bool prepass = engine_->getDepthPrepass();
+    if (ImGui::Checkbox("Terrain Depth Prepass", &prepass)) engine_->setDepthPrepass(prepass);
+    ImGui::Text("Fragments: sky %llu | terrain %llu | scene GPU %.3f ms", (unsigned long long)engine_->getSkyFragments(),
+                (unsigned long long)engine_->getTerrainFragments(), engine_->getSceneGpuMs());
+    bool dynRes = engine_->getDynamicResolution();
+    if (ImGui::Checkbox("Dynamic Resolution", &dynRes)) engine_->setDynamicResolution(dynRes);
+    float gpuBudget = engine_->getResolutionTargetMs();
+    if (ImGui::SliderFloat("GPU Budget (ms)", &gpuBudget, 4.0f, 33.0f)) engine_->setResolutionTargetMs(gpuBudget);
+    const DynamicResolution &dr = engine_->getDynamicResolutionController();
+    ImGui::Text("Scene %dx%d (scale %.2f) | smoothed GPU %.2f ms | %u changes", engine_->getSceneWidth(), engine_->getSceneHeight(),
+                engine_->getResolutionScale(), dr.smoothedMs(), dr.changes());
+    const RenderGraph &graph = engine_->getRenderGraph();
+    ImGui::Text("Render graph: %zu passes (%zu culled), %zu transient textures (%.1f MB)", graph.passCount(), graph.culledPasses(),
+                graph.pooledTextures(), graph.pooledBytes() / (1024.0 * 1024.0));
+
     if (ImGui::Button("Regenerate Terrain")) {
         engine_->regenerateTerrain();
     }
 
     ImGui::End();
 
+    // GPU pass timings (rolling window of GpuPassTimer::WINDOW frames)
+    const GpuPassTimer &timer = engine_->getGpuPassTimer();
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+    ImGui::Begin("GPU Passes", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+    ImGui::Text("%-14s %7s %7s %7s %7s %7s", "pass (ms)", "last", "avg", "p50", "p95", "p99");
+    for (const GpuPassTimer::Stats &st : timer.stats()) {
+        if (!st.active) continue;
+        ImGui::Text("%-14s %7.3f %7.3f %7.3f %7.3f %7.3f", st.name.c_str(), st.lastMs, st.avgMs, st.p50Ms, st.p95Ms, st.p99Ms);
+    }
+    ImGui::Text("frame %.3f ms | dropped results %llu", timer.frameMs(), (unsigned long long)timer.droppedResults());
+    ImGui::End();
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
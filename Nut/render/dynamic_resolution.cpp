@@ -0,0 +1,56 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution() : targetMs_(14.0f), minStep_(10), maxStep_(20), changes_(0) { reset(); }
+
+void DynamicResolution::setScaleRange(float minScale, float maxScale) {
+    const int all = (int)std::lround(1.0f / STEP);
+    minStep_ = std::max(1, std::min(all, (int)std::lround(minScale / STEP)));
+    maxStep_ = std::max(minStep_, std::min(all, (int)std::lround(maxScale / STEP)));
+    step_ = std::max(minStep_, std::min(maxStep_, step_));
+}
+
+void DynamicResolution::reset() {
+    step_ = maxStep_;
+    sceneMs_ = fixedMs_ = 0.0f;
+    settle_ = cooldown_ = 0;
+    primed_ = false;
+}
+
+bool DynamicResolution::update(float sceneMs, float fixedMs) {
+    if (!(sceneMs > 0.0f)) return false;
+    // Results still in flight after a change were measured at the old size
+    if (cooldown_ > 0) { --cooldown_; return false; }
+    fixedMs = std::max(fixedMs, 0.0f);
+    sceneMs_ = primed_ ? sceneMs_ + SMOOTHING * (sceneMs - sceneMs_) : sceneMs;
+    fixedMs_ = primed_ ? fixedMs_ + SMOOTHING * (fixedMs - fixedMs_) : fixedMs;
+    primed_ = true;
+
+    // Predicted scene time at another step, from the pixel count ratio; the
+    // fixed passes take the same time at every step
+    auto scene = [&](int step) { return sceneMs_ * (float)(step * step) / (float)(step_ * step_); };
+    auto predict = [&](int step) { return fixedMs_ + scene(step); };
+    int next = step_;
+    if (predict(step_) > targetMs_) {
+        float sceneBudget = std::max(targetMs_ - fixedMs_, 0.0f);
+        next = (int)std::floor(step_ * std::sqrt(sceneBudget / sceneMs_));
+        next = std::min(next, step_ - 1);
+        settle_ = 0;
+    } else if (step_ < maxStep_ && predict(step_ + 1) < targetMs_ * HEADROOM) {
+        if (++settle_ >= SETTLE_FRAMES) next = step_ + 1;
+    } else {
+        settle_ = 0;
+    }
+    next = std::max(minStep_, std::min(maxStep_, next));
+    if (next == step_) return false;
+
+    // Start the average from the prediction instead of relearning it
+    sceneMs_ = scene(next);
+    step_ = next;
+    settle_ = 0;
+    cooldown_ = COOLDOWN_FRAMES;
+    ++changes_;
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// Render scale controller: keeps the measured GPU frame time near a budget
+// by stepping the 3D scene's resolution (scale per axis, in STEP quanta).
+// Each frame is fed as scene time, taken as proportional to the scene's
+// pixel count, plus the fixed time of native-resolution passes, which the
+// scale doesn't change. Both are smoothed with an exponential moving average.
+// Over budget, the scale drops at once to the step whose predicted time
+// fits. It grows one step only after SETTLE_FRAMES frames in which the
+// predicted time at the larger step stays below HEADROOM of the budget.
+// Every change is followed by COOLDOWN_FRAMES whose samples are skipped,
+// since results measured at the old size are still arriving. The gap between
+// the two thresholds is the hysteresis that keeps it from oscillating.
+class DynamicResolution {
+public:
+    static constexpr float STEP = 0.05f;
+    static constexpr float SMOOTHING = 0.1f;     // weight of a new sample
+    static constexpr float HEADROOM = 0.9f;
+    static const int SETTLE_FRAMES = 30;
+    static const int COOLDOWN_FRAMES = 8;        // > GpuPassTimer::FRAMES of result latency
+
+    DynamicResolution();
+
+    void setTargetMs(float ms) { targetMs_ = ms > 0.0f ? ms : targetMs_; }
+    float targetMs() const { return targetMs_; }
+    // Scale bounds per axis, 0 < min <= max <= 1 (snapped to STEP)
+    void setScaleRange(float minScale, float maxScale);
+    float minScale() const { return minStep_ * STEP; }
+    float maxScale() const { return maxStep_ * STEP; }
+
+    // Feed the GPU time of the latest completed frame: scene passes and
+    // native-resolution passes (frames without scene time are ignored);
+    // true when the scale changed
+    bool update(float sceneMs, float fixedMs);
+    // Back to the maximum scale, history dropped
+    void reset();
+
+    float scale() const { return step_ * STEP; }
+    float smoothedMs() const { return sceneMs_ + fixedMs_; }
+    unsigned changes() const { return changes_; }
+
+private:
+    float targetMs_, sceneMs_, fixedMs_;    // smoothed
+    int step_, minStep_, maxStep_;
+    int settle_, cooldown_;
+    bool primed_;
+    unsigned changes_;
+};
@@ -0,0 +1,28 @@
+#include "frame_uniforms.h"
+
+void FrameUniformBuffer::create() {
+    if (ubo_) return;
+    glGenBuffers(1, &ubo_);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo_);
+}
+
+void FrameUniformBuffer::destroy() {
+    if (ubo_) glDeleteBuffers(1, &ubo_);
+    ubo_ = 0;
+}
+
+void FrameUniformBuffer::attach(GLuint program) {
+    if (!program) return;
+    GLuint block = glGetUniformBlockIndex(program, "Frame");
+    if (block != GL_INVALID_INDEX) glUniformBlockBinding(program, block, BINDING);
+}
+
+void FrameUniformBuffer::update(const FrameUniforms &u) {
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &u);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// CPU mirror of the std140 `Frame` uniform block declared in the terrain and
+// sky shaders. Only mat4 / vec4-sized members, so std140 adds no padding
+// beyond the vec3 + float pair at the end; keep the order in sync with GLSL.
+struct FrameUniforms {
+    glm::mat4 view, proj, viewProj;
+    glm::mat4 invView, invProj;
+    glm::mat4 model;
+    glm::mat4 normalMatrix;   // transpose(inverse(mat3(model))), upper 3x3 used
+    glm::vec3 viewPos;
+    float time;               // seconds since start (sky animation)
+};
+static_assert(sizeof(FrameUniforms) == 7 * 64 + 16, "FrameUniforms must match the std140 Frame block");
+
+// One uniform buffer holding FrameUniforms, filled once per frame and bound
+// at a fixed binding point shared by every program that declares `Frame`.
+class FrameUniformBuffer {
+public:
+    static const GLuint BINDING = 0;
+
+    void create();
+    void destroy();
+
+    // Route program's Frame block to BINDING (once, after linking; programs
+    // without the block are ignored)
+    static void attach(GLuint program);
+
+    // Upload this frame's values (orphans the previous storage)
+    void update(const FrameUniforms &u);
+
+private:
+    GLuint ubo_ = 0;
+};
@@ -0,0 +1,84 @@
+#include "gl_state.h"
+
+namespace {
+int capIndex(GLenum cap) {
+    switch (cap) {
+    case GL_DEPTH_TEST: return 0;
+    case GL_CULL_FACE: return 1;
+    case GL_BLEND: return 2;
+    default: return -1;
+    }
+}
+}
+
+void GLState::invalidate() {
+    program_ = vao_ = fbo_ = activeUnit_ = UNKNOWN;
+    for (GLuint &t : textures_) t = UNKNOWN;
+    for (int &c : caps_) c = -1;
+    depthFunc_ = 0; depthMask_ = colorMask_ = -1;
+    viewportKnown_ = false;
+}
+
+void GLState::useProgram(GLuint program) {
+    if (elide(program_ == program)) return;
+    glUseProgram(program); program_ = program;
+}
+
+void GLState::bindVertexArray(GLuint vao) {
+    if (elide(vao_ == vao)) return;
+    glBindVertexArray(vao); vao_ = vao;
+}
+
+void GLState::activeTexture(GLuint unit) {
+    if (elide(activeUnit_ == unit)) return;
+    glActiveTexture(GL_TEXTURE0 + unit); activeUnit_ = unit;
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    bool cached = target == GL_TEXTURE_2D && unit < (GLuint)UNITS;
+    if (cached && elide(textures_[unit] == texture)) return;
+    activeTexture(unit);
+    if (!cached) ++frame_.issued;
+    glBindTexture(target, texture);
+    if (cached) textures_[unit] = texture;
+}
+
+void GLState::bindFramebuffer(GLuint fbo) {
+    if (elide(fbo_ == fbo)) return;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo); fbo_ = fbo;
+}
+
+void GLState::setCap(GLenum cap, bool on) {
+    int i = capIndex(cap);
+    if (i >= 0 && elide(caps_[i] == (int)on)) return;
+    if (i < 0) ++frame_.issued;
+    if (on) glEnable(cap); else glDisable(cap);
+    if (i >= 0) caps_[i] = on;
+}
+
+void GLState::depthFunc(GLenum func) {
+    if (elide(depthFunc_ == func)) return;
+    glDepthFunc(func); depthFunc_ = func;
+}
+
+void GLState::depthMask(bool write) {
+    if (elide(depthMask_ == (int)write)) return;
+    glDepthMask(write ? GL_TRUE : GL_FALSE); depthMask_ = write;
+}
+
+void GLState::colorMask(bool write) {
+    if (elide(colorMask_ == (int)write)) return;
+    GLboolean w = write ? GL_TRUE : GL_FALSE;
+    glColorMask(w, w, w, w); colorMask_ = write;
+}
+
+void GLState::viewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+    if (elide(viewportKnown_ && viewport_[0] == x && viewport_[1] == y && viewport_[2] == w && viewport_[3] == h)) return;
+    glViewport(x, y, w, h);
+    viewport_[0] = x; viewport_[1] = y; viewport_[2] = w; viewport_[3] = h; viewportKnown_ = true;
+}
+
+void GLState::forgetProgram(GLuint program) { if (program_ == program) program_ = UNKNOWN; }
+void GLState::forgetVertexArray(GLuint vao) { if (vao_ == vao) vao_ = UNKNOWN; }
+void GLState::forgetTexture(GLuint texture) { for (GLuint &t : textures_) if (t == texture) t = UNKNOWN; }
+void GLState::forgetFramebuffer(GLuint fbo) { if (fbo_ == fbo) fbo_ = UNKNOWN; }
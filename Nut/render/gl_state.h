@@ -0,0 +1,59 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+
+// Thin cache in front of the GL state the engine changes every frame
+// (program, VAO, texture units, capabilities, depth/colour writes,
+// framebuffer, viewport). Calls that would not change anything are skipped
+// and counted. Code that changes GL state behind its back (ImGui, raw GL
+// calls) must call invalidate(); deleting an object that may be bound must
+// go through the matching forget*() so a recycled name is bound again.
+class GLState {
+public:
+    struct Stats { uint32_t issued = 0, elided = 0; };
+
+    GLState() { invalidate(); }
+
+    // Forget everything: the next call of each kind is issued
+    void invalidate();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    // GL_TEXTURE_2D bindings are cached per unit; other targets pass through
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void bindFramebuffer(GLuint fbo);
+    // GL_DEPTH_TEST, GL_CULL_FACE and GL_BLEND are cached; others pass through
+    void enable(GLenum cap) { setCap(cap, true); }
+    void disable(GLenum cap) { setCap(cap, false); }
+    void setCap(GLenum cap, bool on);
+    void depthFunc(GLenum func);
+    void depthMask(bool write);
+    void colorMask(bool write);
+    void viewport(GLint x, GLint y, GLsizei w, GLsizei h);
+
+    void forgetProgram(GLuint program);
+    void forgetVertexArray(GLuint vao);
+    void forgetTexture(GLuint texture);
+    void forgetFramebuffer(GLuint fbo);
+
+    // Start a new frame: the counters so far become lastFrame()
+    void beginFrame() { last_ = frame_; frame_ = Stats(); }
+    const Stats& lastFrame() const { return last_; }
+
+    static const int UNITS = 16;
+
+private:
+    bool elide(bool same) { if (same) ++frame_.elided; else ++frame_.issued; return same; }
+    void activeTexture(GLuint unit);
+
+    static const GLuint UNKNOWN = ~0u;
+    GLuint program_, vao_, fbo_, activeUnit_;
+    GLuint textures_[UNITS];
+    int caps_[3];                 // depth test, cull face, blend: -1 unknown
+    GLenum depthFunc_;
+    int depthMask_, colorMask_;   // -1 unknown
+    GLint viewport_[4];
+    bool viewportKnown_;
+    Stats frame_, last_;
+};
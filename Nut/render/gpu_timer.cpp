@@ -0,0 +1,103 @@
+#include "gpu_timer.h"
+
+#include <algorithm>
+
+GpuPassTimer::GpuPassTimer() : frame_(0), slot_(0), open_(-1), dropped_(0) {}
+
+void GpuPassTimer::beginFrame() {
+    ++frame_;
+    slot_ = (int)(frame_ % FRAMES);
+}
+
+GpuPassTimer::Pass* GpuPassTimer::find(const char* name) {
+    for (Pass &p : passes_) if (p.name == name) return &p;
+    return nullptr;
+}
+
+// Result of the query issued FRAMES frames ago in this slot, if it is ready
+void GpuPassTimer::collect(Pass &p, int slot) {
+    if (!p.pending[slot]) return;
+    p.pending[slot] = false;
+    GLuint ready = 0;
+    glGetQueryObjectuiv(p.queries[slot], GL_QUERY_RESULT_AVAILABLE, &ready);
+    if (!ready) { ++dropped_; return; }
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(p.queries[slot], GL_QUERY_RESULT, &ns);
+    p.last = (float)(ns * 1e-6);
+    ++p.results;
+    p.window[p.head] = p.last;
+    p.head = (p.head + 1) % WINDOW;
+    p.count = std::min(p.count + 1, WINDOW);
+}
+
+void GpuPassTimer::begin(const char* pass) {
+    Pass* p = find(pass);
+    if (!p) {
+        Pass n;
+        n.name = pass;
+        glGenQueries(FRAMES, n.queries);
+        std::fill(n.pending, n.pending + FRAMES, false);
+        n.count = n.head = 0; n.last = 0.0f; n.results = n.lastFrame = 0;
+        passes_.push_back(n);
+        p = &passes_.back();
+    }
+    collect(*p, slot_);
+    p->lastFrame = frame_;
+    open_ = (int)(p - passes_.data());
+    glBeginQuery(GL_TIME_ELAPSED, p->queries[slot_]);
+}
+
+void GpuPassTimer::end() {
+    if (open_ < 0) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    passes_[open_].pending[slot_] = true;
+    open_ = -1;
+}
+
+void GpuPassTimer::destroy() {
+    for (Pass &p : passes_) glDeleteQueries(FRAMES, p.queries);
+    passes_.clear();
+    open_ = -1;
+}
+
+GpuPassTimer::Stats GpuPassTimer::summarize(const Pass &p) const {
+    Stats s;
+    s.name = p.name; s.lastMs = p.last; s.samples = p.count; s.results = p.results;
+    s.active = p.lastFrame == frame_;
+    s.avgMs = s.p50Ms = s.p95Ms = s.p99Ms = s.maxMs = 0.0f;
+    if (!p.count) return s;
+    float sorted[WINDOW];
+    std::copy(p.window, p.window + p.count, sorted);
+    std::sort(sorted, sorted + p.count);
+    double sum = 0.0;
+    for (int i = 0; i < p.count; ++i) sum += sorted[i];
+    // Nearest-rank percentiles
+    auto rank = [&](float q) { return sorted[std::min(p.count - 1, (int)(q * p.count))]; };
+    s.avgMs = (float)(sum / p.count);
+    s.p50Ms = rank(0.50f); s.p95Ms = rank(0.95f); s.p99Ms = rank(0.99f);
+    s.maxMs = sorted[p.count - 1];
+    return s;
+}
+
+std::vector<GpuPassTimer::Stats> GpuPassTimer::stats() const {
+    std::vector<Stats> out;
+    out.reserve(passes_.size());
+    for (const Pass &p : passes_) out.push_back(summarize(p));
+    return out;
+}
+
+bool GpuPassTimer::stats(const char* pass, Stats &out) const {
+    for (const Pass &p : passes_) if (p.name == pass) { out = summarize(p); return true; }
+    return false;
+}
+
+float GpuPassTimer::frameMs() const {
+    float ms = 0.0f;
+    for (const Pass &p : passes_) if (p.lastFrame == frame_) ms += p.last;
+    return ms;
+}
+
+float GpuPassTimer::passMs(const char* pass) const {
+    for (const Pass &p : passes_) if (p.name == pass) return p.lastFrame == frame_ ? p.last : 0.0f;
+    return 0.0f;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GPU time per named pass from GL_TIME_ELAPSED queries. Every pass owns
+// FRAMES query objects used round-robin: a result is collected when its
+// slot comes round again, and only if the GPU has already finished it, so
+// reading never stalls (an unfinished result is dropped and counted).
+// Collected times feed a rolling window of WINDOW samples per pass.
+//
+// GL_TIME_ELAPSED queries cannot nest: begin()/end() pairs must not overlap.
+class GpuPassTimer {
+public:
+    static const int FRAMES = 2;     // query sets in flight
+    static const int WINDOW = 120;   // samples kept per pass
+
+    struct Stats {
+        std::string name;
+        float lastMs, avgMs, p50Ms, p95Ms, p99Ms, maxMs;
+        int samples;
+        uint64_t results;            // collected since the pass was first seen
+        bool active;                 // ran during the latest frame
+    };
+
+    GpuPassTimer();
+
+    // Advance to the next query set (once per frame, before any begin())
+    void beginFrame();
+    void begin(const char* pass);
+    void end();
+
+    // Delete every query object (GL context current)
+    void destroy();
+
+    // Rolling stats of every pass seen so far, in first-seen order
+    std::vector<Stats> stats() const;
+    bool stats(const char* pass, Stats &out) const;
+    // Sum of the latest results of the active passes
+    float frameMs() const;
+    // Latest result of one pass, 0 unless it is active
+    float passMs(const char* pass) const;
+    uint64_t droppedResults() const { return dropped_; }
+
+private:
+    struct Pass {
+        std::string name;
+        GLuint queries[FRAMES];
+        bool pending[FRAMES];
+        float window[WINDOW];
+        int count, head;
+        float last;
+        uint64_t results;
+        uint64_t lastFrame;
+    };
+
+    Pass* find(const char* name);
+    void collect(Pass &p, int slot);
+    Stats summarize(const Pass &p) const;
+
+    std::vector<Pass> passes_;
+    uint64_t frame_;
+    int slot_;
+    int open_;                       // pass index inside begin()/end(), -1 none
+    uint64_t dropped_;
+};
@@ -0,0 +1,71 @@
+#include "headless_context.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstring>
+#include <iostream>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace {
+bool hasExtension(const char* list, const char* name) {
+    if (!list) return false;
+    size_t n = std::strlen(name);
+    for (const char* p = std::strstr(list, name); p; p = std::strstr(p + n, name))
+        if ((p == list || p[-1] == ' ') && (p[n] == ' ' || p[n] == '\0')) return true;
+    return false;
+}
+}
+
+bool HeadlessContext::create(int major, int minor) {
+    destroy();
+
+    // Surfaceless display when the client library offers it
+    EGLDisplay display = EGL_NO_DISPLAY;
+    bool surfaceless = false;
+    const char* clientExt = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (hasExtension(clientExt, "EGL_MESA_platform_surfaceless")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        surfaceless = display != EGL_NO_DISPLAY;
+    }
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        std::cerr << "Headless: no EGL display" << std::endl; return false;
+    }
+    display_ = display;
+    if (!eglBindAPI(EGL_OPENGL_API)) { std::cerr << "Headless: EGL has no desktop OpenGL" << std::endl; destroy(); return false; }
+
+    // Surfaceless contexts need no config; the fallback renders to a pbuffer
+    EGLConfig config = nullptr;
+    surfaceless = surfaceless && hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+    if (!surfaceless) {
+        const EGLint attrs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_NONE};
+        EGLint count = 0;
+        if (!eglChooseConfig(display, attrs, &config, 1, &count) || count == 0) { std::cerr << "Headless: no pbuffer config" << std::endl; destroy(); return false; }
+        const EGLint pbuffer[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        surface_ = eglCreatePbufferSurface(display, config, pbuffer);
+        if (surface_ == EGL_NO_SURFACE) { surface_ = nullptr; std::cerr << "Headless: pbuffer creation failed" << std::endl; destroy(); return false; }
+    }
+
+    const EGLint ctxAttrs[] = {EGL_CONTEXT_MAJOR_VERSION, major, EGL_CONTEXT_MINOR_VERSION, minor,
+                               EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, ctxAttrs);
+    if (context == EGL_NO_CONTEXT) { std::cerr << "Headless: cannot create a GL " << major << "." << minor << " core context" << std::endl; destroy(); return false; }
+    context_ = context;
+    EGLSurface surface = surface_ ? (EGLSurface)surface_ : EGL_NO_SURFACE;
+    if (!eglMakeCurrent(display, surface, surface, context)) { std::cerr << "Headless: eglMakeCurrent failed" << std::endl; destroy(); return false; }
+    return true;
+}
+
+void HeadlessContext::destroy() {
+    if (!display_) return;
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context_) eglDestroyContext(display_, context_);
+    if (surface_) eglDestroySurface(display_, surface_);
+    eglTerminate(display_);
+    display_ = context_ = surface_ = nullptr;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// OpenGL 3.3 core context without a window or display server, for
+// benchmark hosts: EGL on Mesa's surfaceless platform (llvmpipe or a GPU
+// render node), falling back to the default EGL display with a 1x1 pbuffer.
+// There is no default framebuffer to present; render into an FBO.
+class HeadlessContext {
+public:
+    HeadlessContext() = default;
+    ~HeadlessContext() { destroy(); }
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // Create the context and make it current on the calling thread
+    bool create(int major = 3, int minor = 3);
+    void destroy();
+    bool valid() const { return context_ != nullptr; }
+
+private:
+    void* display_ = nullptr;
+    void* context_ = nullptr;
+    void* surface_ = nullptr;   // pbuffer on the fallback path
+};
@@ -0,0 +1,351 @@
+#include "render_graph.h"
+#include "gl_state.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+bool isDepth(GLenum f) {
+    switch (f) {
+    case GL_DEPTH_COMPONENT16: case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32: case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8: case GL_DEPTH32F_STENCIL8:
+        return true;
+    default: return false;
+    }
+}
+
+bool hasStencil(GLenum f) { return f == GL_DEPTH24_STENCIL8 || f == GL_DEPTH32F_STENCIL8; }
+
+size_t bytesPerPixel(GLenum f) {
+    switch (f) {
+    case GL_R8: return 1;
+    case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+    case GL_RGBA16F: case GL_DEPTH32F_STENCIL8: return 8;
+    case GL_RGBA32F: return 16;
+    default: return 4;   // RGBA8, R32F, RG16F, R11F_G11F_B10F, 24/32-bit depth
+    }
+}
+
+GLuint createTexture(GLState &gl, GLenum format, int w, int h) {
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    gl.bindTexture(0, GL_TEXTURE_2D, tex);
+    if (isDepth(format)) {
+        if (hasStencil(format))
+            glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, GL_DEPTH_STENCIL,
+                         format == GL_DEPTH24_STENCIL8 ? GL_UNSIGNED_INT_24_8 : GL_FLOAT_32_UNSIGNED_INT_24_8_REV, nullptr);
+        else
+            glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    GLint filter = isDepth(format) ? GL_NEAREST : GL_LINEAR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return tex;
+}
+}
+
+// ---------------- Declaration ----------------
+
+// Resource called name, added undefined when nobody mentioned it yet
+RenderGraph::Resource RenderGraph::named(const char* name) {
+    for (size_t i = 0; i < resources_.size(); ++i) if (resources_[i].name == name) return (Resource)i;
+    ResourceNode r;
+    r.name = name; r.imported = false; r.defined = false;
+    r.first = r.last = r.slot = -1;
+    resources_.push_back(r);
+    return (Resource)resources_.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::Builder::create(const char* name, const RGTextureDesc &desc) {
+    Resource r = graph_.named(name);
+    ResourceNode &node = graph_.resources_[r];
+    if (node.defined || node.imported) { graph_.passes_[pass_].duplicate = true; return r; }
+    node.desc = desc; node.defined = true;
+    return r;
+}
+
+RenderGraph::Resource RenderGraph::Builder::read(const char* name) { return read(graph_.named(name)); }
+
+RenderGraph::Resource RenderGraph::Builder::read(Resource r) {
+    graph_.passes_[pass_].reads.push_back(r);
+    if (r >= 0 && r < (Resource)graph_.resources_.size()) graph_.resources_[r].readers.push_back(pass_);
+    return r;
+}
+
+RenderGraph::Resource RenderGraph::Builder::write(Resource r) {
+    graph_.passes_[pass_].writes.push_back(r);
+    if (r >= 0 && r < (Resource)graph_.resources_.size()) graph_.resources_[r].writers.push_back(pass_);
+    return r;
+}
+
+void RenderGraph::Builder::sideEffect() { graph_.passes_[pass_].sideEffect = true; }
+
+GLuint RenderGraph::Context::texture(Resource r) const {
+    const ResourceNode &node = graph->resources_[r];
+    return node.slot >= 0 ? graph->pool_[node.slot].texture : 0;
+}
+
+RenderGraph::RenderGraph() : width_(0), height_(0), backbuffer_(0), valid_(false) {}
+
+void RenderGraph::beginFrame(int width, int height, const float clearColor[4], GLuint backbuffer) {
+    width_ = width; height_ = height; backbuffer_ = backbuffer;
+    passes_.clear(); resources_.clear(); order_.clear();
+    valid_ = false;
+
+    // Imported backbuffer: colour and depth of one framebuffer
+    const char* names[2] = {"backbuffer", "backbuffer_depth"};
+    GLenum formats[2] = {GL_RGBA8, GL_DEPTH_COMPONENT24};
+    for (int i = 0; i < 2; ++i) {
+        ResourceNode r;
+        r.name = names[i]; r.desc.format = formats[i]; r.desc.clear = true;
+        std::copy(clearColor, clearColor + 4, r.desc.clearColor);
+        r.imported = r.defined = true; r.first = r.last = r.slot = -1;
+        resources_.push_back(r);
+    }
+}
+
+void RenderGraph::addPass(const char* name, const SetupFn &setup, const ExecuteFn &execute) {
+    PassNode p;
+    p.name = name; p.label = name; p.execute = execute; p.sideEffect = p.duplicate = false;
+    passes_.push_back(p);
+    Builder b(*this, (int)passes_.size() - 1);
+    setup(b);
+}
+
+// ---------------- Compile (CPU only) ----------------
+
+void RenderGraph::fail(const std::string &msg) {
+    std::cerr << "Render graph: " << msg << std::endl;
+    valid_ = false; order_.clear();
+}
+
+void RenderGraph::resolvedSize(const RGTextureDesc &desc, int &w, int &h) const {
+    w = desc.width > 0 ? desc.width : width_;
+    h = desc.height > 0 ? desc.height : height_;
+}
+
+bool RenderGraph::compile() {
+    const int n = (int)passes_.size();
+    const int nr = (int)resources_.size();
+    order_.clear();
+
+    // Validate attachment sets
+    for (const PassNode &p : passes_) {
+        if (p.duplicate) { fail(p.name + " creates a resource that already exists"); return false; }
+        int imported = 0, depth = 0, w = -1, h = -1;
+        for (Resource r : p.writes) {
+            if (r < 0 || r >= nr) { fail(p.name + " writes an unknown resource"); return false; }
+            if (std::find(p.reads.begin(), p.reads.end(), r) != p.reads.end()) { fail(p.name + " reads and writes " + resources_[r].name); return false; }
+            const ResourceNode &res = resources_[r];
+            if (!res.defined) { fail(p.name + " writes " + res.name + ", which no pass creates"); return false; }
+            imported += res.imported;
+            depth += isDepth(res.desc.format);
+            int rw, rh; resolvedSize(res.desc, rw, rh);
+            if (w >= 0 && (rw != w || rh != h)) { fail(p.name + " writes targets of different sizes"); return false; }
+            w = rw; h = rh;
+        }
+        for (Resource r : p.reads) {
+            if (r < 0 || r >= nr || resources_[r].imported) { fail(p.name + " reads an unknown or imported resource"); return false; }
+            if (!resources_[r].defined) { fail(p.name + " reads " + resources_[r].name + ", which no pass creates"); return false; }
+        }
+        if (imported && imported != (int)p.writes.size()) { fail(p.name + " mixes backbuffer and transient targets"); return false; }
+        if (depth > 1) { fail(p.name + " writes more than one depth target"); return false; }
+    }
+
+    // Dependencies: writers of a resource in declaration order, then every
+    // reader after every writer
+    std::vector<std::vector<int>> next(n);
+    std::vector<int> indegree(n, 0);
+    auto edge = [&](int a, int b) { next[a].push_back(b); ++indegree[b]; };
+    for (const ResourceNode &r : resources_) {
+        for (size_t i = 1; i < r.writers.size(); ++i)
+            if (r.writers[i - 1] != r.writers[i]) edge(r.writers[i - 1], r.writers[i]);
+        for (int w : r.writers) for (int rd : r.readers) edge(w, rd);
+    }
+
+    // Topological order, earliest declared ready pass first
+    std::vector<int> sorted;
+    std::vector<char> done(n, 0);
+    sorted.reserve(n);
+    while ((int)sorted.size() < n) {
+        int pick = -1;
+        for (int i = 0; i < n && pick < 0; ++i) if (!done[i] && indegree[i] == 0) pick = i;
+        if (pick < 0) { fail("dependency cycle"); return false; }
+        done[pick] = 1; sorted.push_back(pick);
+        for (int b : next[pick]) --indegree[b];
+    }
+
+    // Cull: keep passes that reach the backbuffer or have side effects, and
+    // everything that produces what a kept pass reads or overwrites
+    std::vector<char> live(n, 0);
+    for (int i = 0; i < n; ++i) {
+        live[i] = passes_[i].sideEffect;
+        for (Resource r : passes_[i].writes) if (resources_[r].imported) live[i] = 1;
+    }
+    for (int k = n - 1; k >= 0; --k) {
+        int p = sorted[k];
+        if (!live[p]) continue;
+        for (Resource r : passes_[p].reads) for (int w : resources_[r].writers) live[w] = 1;
+        for (Resource r : passes_[p].writes)
+            for (int w : resources_[r].writers) { if (w == p) break; live[w] = 1; }
+    }
+    for (int p : sorted) if (live[p]) order_.push_back(p);
+
+    // Lifetimes of transient resources over the executed order
+    for (ResourceNode &r : resources_) { r.first = r.last = r.slot = -1; }
+    for (int pos = 0; pos < (int)order_.size(); ++pos) {
+        const PassNode &p = passes_[order_[pos]];
+        for (const std::vector<Resource>* list : {&p.reads, &p.writes})
+            for (Resource r : *list) {
+                ResourceNode &res = resources_[r];
+                if (res.imported) continue;
+                if (res.first < 0) res.first = pos;
+                res.last = pos;
+            }
+    }
+
+    // Assign pool slots: storage released after a resource's last use can be
+    // taken by one whose first use comes later
+    for (PoolTexture &t : pool_) t.taken = false;
+    std::vector<char> used(pool_.size(), 0);
+    for (int pos = 0; pos < (int)order_.size(); ++pos) {
+        for (ResourceNode &r : resources_) if (r.first == pos) {
+            r.slot = acquire(r.desc);
+            if (r.slot >= (int)used.size()) used.resize(r.slot + 1, 0);
+            used[r.slot] = 1;
+        }
+        for (ResourceNode &r : resources_) if (r.last == pos) pool_[r.slot].taken = false;
+    }
+    for (size_t i = 0; i < pool_.size(); ++i) pool_[i].idle = used[i] ? 0 : pool_[i].idle + 1;
+
+    valid_ = true;
+    return true;
+}
+
+int RenderGraph::acquire(const RGTextureDesc &desc) {
+    int w, h; resolvedSize(desc, w, h);
+    for (size_t i = 0; i < pool_.size(); ++i) {
+        PoolTexture &t = pool_[i];
+        if (!t.taken && t.format == desc.format && t.width == w && t.height == h) { t.taken = true; return (int)i; }
+    }
+    PoolTexture t;
+    t.format = desc.format; t.width = w; t.height = h;
+    t.texture = 0; t.idle = 0; t.taken = true;
+    pool_.push_back(t);
+    return (int)pool_.size() - 1;
+}
+
+size_t RenderGraph::transientResources() const {
+    size_t count = 0;
+    for (const ResourceNode &r : resources_) count += r.slot >= 0;
+    return count;
+}
+
+size_t RenderGraph::pooledBytes() const {
+    size_t bytes = 0;
+    for (const PoolTexture &t : pool_) bytes += (size_t)t.width * t.height * bytesPerPixel(t.format);
+    return bytes;
+}
+
+// ---------------- Execute (GL) ----------------
+
+// Delete textures idle for RETIRE_FRAMES and every framebuffer using them
+void RenderGraph::retire(GLState &gl) {
+    std::vector<int> remap(pool_.size(), -1);
+    std::vector<PoolTexture> kept;
+    for (size_t i = 0; i < pool_.size(); ++i) {
+        PoolTexture &t = pool_[i];
+        if (t.idle <= RETIRE_FRAMES) { remap[i] = (int)kept.size(); kept.push_back(t); continue; }
+        if (!t.texture) continue;
+        for (size_t f = 0; f < framebuffers_.size();) {
+            Framebuffer &fb = framebuffers_[f];
+            if (std::find(fb.attachments.begin(), fb.attachments.end(), t.texture) == fb.attachments.end()) { ++f; continue; }
+            gl.forgetFramebuffer(fb.fbo); glDeleteFramebuffers(1, &fb.fbo);
+            framebuffers_.erase(framebuffers_.begin() + f);
+        }
+        gl.forgetTexture(t.texture); glDeleteTextures(1, &t.texture);
+    }
+    if (kept.size() == pool_.size()) return;
+    pool_.swap(kept);
+    for (ResourceNode &r : resources_) if (r.slot >= 0) r.slot = remap[r.slot];
+}
+
+GLuint RenderGraph::framebufferFor(GLState &gl, const PassNode &pass, int &w, int &h) {
+    if (resources_[pass.writes[0]].imported) { w = width_; h = height_; return backbuffer_; }
+
+    // Key: colour textures in write order, then depth (0 when none)
+    std::vector<GLuint> key;
+    GLuint depth = 0; GLenum depthFormat = 0;
+    for (Resource r : pass.writes) {
+        const PoolTexture &t = pool_[resources_[r].slot];
+        w = t.width; h = t.height;
+        if (isDepth(t.format)) { depth = t.texture; depthFormat = t.format; } else key.push_back(t.texture);
+    }
+    key.push_back(depth);
+    for (const Framebuffer &fb : framebuffers_) if (fb.attachments == key) return fb.fbo;
+
+    Framebuffer fb;
+    fb.attachments = key;
+    glGenFramebuffers(1, &fb.fbo);
+    gl.bindFramebuffer(fb.fbo);
+    std::vector<GLenum> drawBuffers;
+    for (size_t i = 0; i + 1 < key.size(); ++i) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)i, GL_TEXTURE_2D, key[i], 0);
+        drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+    }
+    if (depth) glFramebufferTexture2D(GL_FRAMEBUFFER, hasStencil(depthFormat) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+    if (drawBuffers.empty()) { glDrawBuffer(GL_NONE); glReadBuffer(GL_NONE); }
+    else glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Render graph: incomplete framebuffer for pass " << pass.name << std::endl;
+    framebuffers_.push_back(fb);
+    return fb.fbo;
+}
+
+void RenderGraph::execute(GLState &gl) {
+    retire(gl);
+    if (!valid_) return;
+    for (PoolTexture &t : pool_) if (!t.texture && t.idle == 0) t.texture = createTexture(gl, t.format, t.width, t.height);
+
+    cleared_.assign(resources_.size(), 0);
+    for (int p : order_) {
+        const PassNode &pass = passes_[p];
+        if (beginHook_) beginHook_(pass.label);
+
+        Context ctx;
+        ctx.width = width_; ctx.height = height_; ctx.graph = this;
+        if (!pass.writes.empty()) {
+            GLuint fbo = framebufferFor(gl, pass, ctx.width, ctx.height);
+            gl.bindFramebuffer(fbo);
+            gl.viewport(0, 0, ctx.width, ctx.height);
+
+            // First write of a cleared resource clears it
+            GLint colorIndex = 0;
+            for (Resource r : pass.writes) {
+                const ResourceNode &res = resources_[r];
+                bool depth = isDepth(res.desc.format);
+                if (res.desc.clear && !cleared_[r]) {
+                    cleared_[r] = 1;
+                    if (depth) { const GLfloat one = 1.0f; gl.depthMask(true); glClearBufferfv(GL_DEPTH, 0, &one); }
+                    else { gl.colorMask(true); glClearBufferfv(GL_COLOR, colorIndex, res.desc.clearColor); }
+                }
+                if (!depth) ++colorIndex;
+            }
+        }
+        pass.execute(ctx);
+
+        if (endHook_) endHook_(pass.label);
+    }
+}
+
+void RenderGraph::destroy(GLState &gl) {
+    for (Framebuffer &fb : framebuffers_) { gl.forgetFramebuffer(fb.fbo); glDeleteFramebuffers(1, &fb.fbo); }
+    for (PoolTexture &t : pool_) if (t.texture) { gl.forgetTexture(t.texture); glDeleteTextures(1, &t.texture); }
+    framebuffers_.clear(); pool_.clear();
+    for (ResourceNode &r : resources_) r.slot = -1;
+    valid_ = false;
+}
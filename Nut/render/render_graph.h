@@ -0,0 +1,143 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class GLState;
+
+// Transient texture description. A zero width/height means "backbuffer
+// size"; clear resources are cleared by the first pass that writes them.
+struct RGTextureDesc {
+    GLenum format = GL_RGBA8;     // internal format; GL_DEPTH_COMPONENT* attach as depth
+    int width = 0, height = 0;
+    bool clear = false;
+    float clearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};   // depth clears to 1
+};
+
+// Per-frame render graph. The engine declares its passes every frame: in
+// setup a pass creates, reads and writes resources through the Builder, in
+// execute it draws. compile() (CPU only) orders the passes so every reader
+// runs after all writers of what it reads, culls passes whose outputs nothing
+// consumes, and assigns transient textures from a pool so resources with
+// disjoint lifetimes share storage. execute() creates what the pool lacks,
+// binds each pass's framebuffer (cached per attachment set), applies clears
+// and runs the pass between the begin/end hooks.
+//
+// Writers of one resource run in declaration order; a pass may not read and
+// write the same resource. Reading by name lets a consumer be declared before
+// its producer. The backbuffer is imported as two resources
+// (colour and depth) of one framebuffer: the window's, or an offscreen one
+// in headless mode.
+class RenderGraph {
+public:
+    typedef int Resource;
+    static const Resource BACKBUFFER = 0;
+    static const Resource BACKBUFFER_DEPTH = 1;
+
+    class Builder {
+    public:
+        Resource create(const char* name, const RGTextureDesc &desc);
+        Resource read(Resource r);    // sampled by the pass (Context::texture)
+        Resource read(const char* name);   // by name: the creator may be declared later
+        Resource write(Resource r);   // render target of the pass
+        void sideEffect();            // keep the pass even if nothing reads its outputs
+    private:
+        friend class RenderGraph;
+        Builder(RenderGraph &graph, int pass) : graph_(graph), pass_(pass) {}
+        RenderGraph &graph_;
+        int pass_;
+    };
+
+    struct Context {
+        int width, height;            // render target size (viewport already set)
+        GLuint texture(Resource r) const;
+        const RenderGraph* graph;
+    };
+
+    typedef std::function<void(Builder&)> SetupFn;
+    typedef std::function<void(const Context&)> ExecuteFn;
+    typedef std::function<void(const char* pass)> PassHook;
+
+    RenderGraph();
+
+    // Drop last frame's declarations; the backbuffer is framebuffer
+    // `backbuffer` (0: the window), width x height, and cleared to clearColor
+    // (depth to 1) by its first writer
+    void beginFrame(int width, int height, const float clearColor[4], GLuint backbuffer = 0);
+    // name is also handed to the pass hooks, which may keep it (profiler
+    // zones): pass a string literal
+    void addPass(const char* name, const SetupFn &setup, const ExecuteFn &execute);
+
+    // Order, cull and assign storage; false (with a message) on a cycle or an
+    // invalid attachment set, in which case execute() draws nothing
+    bool compile();
+    void execute(GLState &gl);
+
+    // Called around every executed pass (timers, profiler zones)
+    void setPassHooks(const PassHook &begin, const PassHook &end) { beginHook_ = begin; endHook_ = end; }
+
+    // Delete pooled textures and framebuffers (GL context current)
+    void destroy(GLState &gl);
+
+    // Last compiled frame
+    size_t passCount() const { return passes_.size(); }
+    size_t culledPasses() const { return passes_.size() - order_.size(); }
+    const std::vector<int>& order() const { return order_; }
+    const char* passName(int pass) const { return passes_[pass].name.c_str(); }
+    size_t transientResources() const;
+    size_t pooledTextures() const { return pool_.size(); }
+    size_t pooledBytes() const;
+
+    // Frames a pooled texture may sit unused before it is deleted
+    static const int RETIRE_FRAMES = 30;
+
+private:
+    struct ResourceNode {
+        std::string name;
+        RGTextureDesc desc;
+        bool imported, defined;              // defined: created (not just named by a reader)
+        std::vector<int> writers, readers;   // passes, declaration order
+        int first, last;                     // positions in order_, -1 unused
+        int slot;                            // pool_ index, -1 none
+    };
+    struct PassNode {
+        std::string name;
+        const char* label;                   // as given to addPass, for the hooks
+        ExecuteFn execute;
+        std::vector<Resource> reads, writes;
+        bool sideEffect, duplicate;
+    };
+    struct PoolTexture {
+        GLenum format;
+        int width, height;
+        GLuint texture;                      // created by execute()
+        int idle;                            // frames without use
+        bool taken;
+    };
+    struct Framebuffer {
+        std::vector<GLuint> attachments;     // colour..., depth (0 if none)
+        GLuint fbo;
+    };
+
+    void fail(const std::string &msg);
+    Resource named(const char* name);
+    int acquire(const RGTextureDesc &desc);
+    void resolvedSize(const RGTextureDesc &desc, int &w, int &h) const;
+    GLuint framebufferFor(GLState &gl, const PassNode &pass, int &w, int &h);
+    void retire(GLState &gl);
+
+    int width_, height_;
+    GLuint backbuffer_;
+    std::vector<PassNode> passes_;
+    std::vector<ResourceNode> resources_;
+    std::vector<int> order_;
+    std::vector<PoolTexture> pool_;
+    std::vector<Framebuffer> framebuffers_;
+    std::vector<char> cleared_;
+    bool valid_;
+    PassHook beginHook_, endHook_;
+};
@@ -0,0 +1,5 @@
+#version 330 core
+
+// Depth prepass: no colour output, depth comes from the rasterizer
+void main() {
+}
@@ -0,0 +1,37 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// Position-only twin of vertex.glsl for the terrain depth prepass. The
+// position math must stay identical (and invariant) so the colour pass can
+// test GL_LEQUAL against these depths.
+invariant gl_Position;
+
+layout(std140) uniform Frame {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    mat4 invView;
+    mat4 invProj;
+    mat4 model;
+    mat4 normalMatrix;
+    vec3 viewPos;
+    float time;
+};
+
+uniform bool heightMode;
+uniform sampler2D heightTex;
+uniform int gridN;
+uniform int patchQuads;
+uniform int patchesPerSide;
+uniform vec2 gridOrigin;
+uniform float gridSpacing;
+
+void main() {
+    vec3 pos = aPos;
+    if (heightMode) {
+        ivec2 tileId = ivec2(gl_InstanceID % patchesPerSide, gl_InstanceID / patchesPerSide);
+        ivec2 g = min(tileId * patchQuads + ivec2(aPos.xz), ivec2(gridN - 1));
+        pos = vec3(gridOrigin.x + float(g.x) * gridSpacing, texelFetch(heightTex, g, 0).r, gridOrigin.y + float(g.y) * gridSpacing);
+    }
+    gl_Position = viewProj * vec4(vec3(model * vec4(pos, 1.0)), 1.0);
+}
@@ -5,10 +5,22 @@ in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
+// Per-frame values shared by every program (std140, see render/frame_uniforms.h)
+layout(std140) uniform Frame {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    mat4 invView;
+    mat4 invProj;
+    mat4 model;
+    mat4 normalMatrix; // transpose(inverse(mat3(model))), computed on the CPU
+    vec3 viewPos;
+    float time;
+};
+
 uniform sampler2D texture1;
 uniform vec3 lightDir;
 uniform vec3 lightColor;
-uniform vec3 viewPos;
 // uniform vec3 fogColor;
 // uniform float fogDensity;
 uniform bool renderSky;
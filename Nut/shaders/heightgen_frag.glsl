@@ -0,0 +1,32 @@
+#version 330 core
+// GPU port of Nut/terrain/noise.cpp. One fragment per grid sample: pixel
+// (x, z) of the R32F target receives fbm(x * noiseFreq, z * noiseFreq) * heightScale.
+// The integer hash relies on 32-bit wrap-around exactly like the CPU version.
+layout(location = 0) out float outHeight;
+
+uniform float heightScale;
+uniform float noiseFreq;
+
+int hashI(int x, int y) { int n = x + y * 57; n = (n << 13) ^ n; return (n * (n * n * 60493 + 19990303) + 1376312589) & 0x7fffffff; }
+
+float valueNoise(int x, int y) { return (float(hashI(x, y)) / float(0x7fffffff)) * 2.0 - 1.0; } // value noise in [-1,1]
+
+float fade(float t) { return t * t * (3.0 - 2.0 * t); }
+
+float smoothNoise(float x, float y) {
+    int xf = int(floor(x)); int yf = int(floor(y));
+    float xf_frac = x - float(xf); float yf_frac = y - float(yf);
+    float v00 = valueNoise(xf, yf); float v10 = valueNoise(xf + 1, yf); float v01 = valueNoise(xf, yf + 1); float v11 = valueNoise(xf + 1, yf + 1);
+    float i1 = mix(v00, v10, fade(xf_frac)); float i2 = mix(v01, v11, fade(xf_frac)); return mix(i1, i2, fade(yf_frac));
+}
+
+float fbm(float x, float y) {
+    float total = 0.0; float amp = 1.0; float freq = 1.0;
+    for (int i = 0; i < 6; ++i) { total += amp * smoothNoise(x * freq, y * freq); freq *= 2.0; amp *= 0.5; }
+    return total;
+}
+
+void main() {
+    vec2 g = floor(gl_FragCoord.xy); // integer grid coords (x, z)
+    outHeight = fbm(g.x * noiseFreq, g.y * noiseFreq) * heightScale;
+}
@@ -5,8 +5,20 @@ in vec3 vDir;
 uniform sampler2D panorama;
 uniform bool hasPanorama;
 
+// Per-frame values shared by every program (std140, see render/frame_uniforms.h)
+layout(std140) uniform Frame {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    mat4 invView;
+    mat4 invProj;
+    mat4 model;
+    mat4 normalMatrix; // transpose(inverse(mat3(model))), computed on the CPU
+    vec3 viewPos;
+    float time;
+};
+
 // Cloud controls
-uniform float time;            // seconds
 uniform bool cloudEnabled;
 uniform float cloudSpeed;
 uniform float cloudScale;
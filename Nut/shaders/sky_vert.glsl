@@ -2,8 +2,18 @@
 layout(location = 0) in vec2 aPos; // full-screen triangle positions
 out vec3 vDir; // world-space ray direction
 
-uniform mat4 invProj;
-uniform mat4 invView;
+// Per-frame values shared by every program (std140, see render/frame_uniforms.h)
+layout(std140) uniform Frame {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    mat4 invView;
+    mat4 invProj;
+    mat4 model;
+    mat4 normalMatrix; // transpose(inverse(mat3(model))), computed on the CPU
+    vec3 viewPos;
+    float time;
+};
 
 void main() {
     // aPos is in NDC coords: (-1,-1), (3,-1), (-1,3) -> full-screen triangle trick
@@ -18,6 +28,7 @@ void main() {
     vec3 worldDir = mat3(invView) * eye.xyz;
     vDir = normalize(worldDir);
 
-    // we still must output a clip position
-    gl_Position = vec4(aPos, 0.0, 1.0);
+    // Sit on the far plane (z = w): drawn after the terrain with GL_LEQUAL,
+    // early-Z rejects every pixel the terrain already covers
+    gl_Position = vec4(aPos, 1.0, 1.0);
 }
@@ -0,0 +1,11 @@
+#version 330 core
+// Stretches the scaled scene target over the backbuffer (bilinear; the
+// target's filter is GL_LINEAR). Drawn with the full-screen triangle.
+out vec4 FragColor;
+
+uniform sampler2D sceneColor;
+uniform vec2 invTargetSize; // 1 / backbuffer size in pixels
+
+void main() {
+    FragColor = texture(sceneColor, gl_FragCoord.xy * invTargetSize);
+}
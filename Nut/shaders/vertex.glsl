@@ -7,12 +7,59 @@ out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 mvp;
+// Must match depth_vert.glsl bit for bit (depth prepass + GL_LEQUAL)
+invariant gl_Position;
+
+// Per-frame values shared by every program (std140, see render/frame_uniforms.h)
+layout(std140) uniform Frame {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    mat4 invView;
+    mat4 invProj;
+    mat4 model;
+    mat4 normalMatrix; // transpose(inverse(mat3(model))), computed on the CPU
+    vec3 viewPos;
+    float time;
+};
+
+// Height-texture mode: aPos.xz is an integer position inside one instanced
+// grid patch; height, normal and uv come from heightTex (R32F, gridN^2).
+uniform bool heightMode;
+uniform sampler2D heightTex;
+uniform int gridN;
+uniform int patchQuads;
+uniform int patchesPerSide;
+uniform vec2 gridOrigin;
+uniform float gridSpacing;
+uniform vec2 uvParams; // (half extent, textureTile / (2 * half extent))
+
+float heightAt(ivec2 g) {
+    return texelFetch(heightTex, clamp(g, ivec2(0), ivec2(gridN - 1)), 0).r;
+}
 
 void main() {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    TexCoords = aTex;
-    gl_Position = mvp * vec4(aPos, 1.0);
+    vec3 pos = aPos;
+    vec3 nrm = aNormal;
+    vec2 uv = aTex;
+
+    if (heightMode) {
+        ivec2 tileId = ivec2(gl_InstanceID % patchesPerSide, gl_InstanceID / patchesPerSide);
+        ivec2 g = min(tileId * patchQuads + ivec2(aPos.xz), ivec2(gridN - 1));
+
+        // Same central difference as the CPU stencil (one-sided at the borders)
+        float hl = heightAt(g - ivec2(1, 0)), hr = heightAt(g + ivec2(1, 0));
+        float hb = heightAt(g - ivec2(0, 1)), hf = heightAt(g + ivec2(0, 1));
+        float dx = float(min(g.x + 1, gridN - 1) - max(g.x - 1, 0)) * gridSpacing;
+        float dz = float(min(g.y + 1, gridN - 1) - max(g.y - 1, 0)) * gridSpacing;
+        nrm = vec3((hl - hr) * dz, dx * dz, (hb - hf) * dx);
+
+        pos = vec3(gridOrigin.x + float(g.x) * gridSpacing, heightAt(g), gridOrigin.y + float(g.y) * gridSpacing);
+        uv = (pos.xz + uvParams.x) * uvParams.y;
+    }
+
+    FragPos = vec3(model * vec4(pos, 1.0));
+    Normal = mat3(normalMatrix) * nrm;
+    TexCoords = uv;
+    gl_Position = viewProj * vec4(FragPos, 1.0);
 }
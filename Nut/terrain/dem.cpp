@@ -0,0 +1,265 @@
+#include "dem.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// On-disk header of the pyramid file; tile data starts at the next page.
+struct DemTileStore::Header {
+    char magic[8];      // "NUTDEM1"
+    uint64_t width, height;
+    uint32_t tileSize, levels;
+};
+
+static const size_t kPage = 4096;
+static const char kMagic[8] = "NUTDEM1";
+
+static size_t alignPage(size_t v) { return (v + kPage - 1) & ~(kPage - 1); }
+
+// Memory-mapped file (read-only or read-write); unmapped in the destructor
+struct MappedFile {
+    int fd = -1; unsigned char* data = nullptr; size_t size = 0;
+    ~MappedFile() { if (data) munmap(data, size); if (fd >= 0) ::close(fd); }
+};
+
+static bool mapRead(const std::string &path, MappedFile &mf) {
+    mf.fd = ::open(path.c_str(), O_RDONLY);
+    if (mf.fd < 0) return false;
+    struct stat st; if (fstat(mf.fd, &st) != 0 || st.st_size <= 0) return false;
+    mf.size = (size_t)st.st_size;
+    void* p = mmap(nullptr, mf.size, PROT_READ, MAP_SHARED, mf.fd, 0);
+    if (p == MAP_FAILED) return false;
+    mf.data = (unsigned char*)p; return true;
+}
+
+// Parse a binary PGM header. Returns the offset of the first sample or 0.
+static size_t parsePgm(const unsigned char* d, size_t n, int64_t &w, int64_t &h, int &maxval) {
+    if (n < 2 || d[0] != 'P' || d[1] != '5') return 0;
+    size_t i = 2; int64_t vals[3]; int got = 0;
+    while (got < 3 && i < n) {
+        if (d[i] == '#') { while (i < n && d[i] != '\n') ++i; continue; }
+        if (isspace(d[i])) { ++i; continue; }
+        int64_t v = 0; bool any = false;
+        while (i < n && d[i] >= '0' && d[i] <= '9') { v = v * 10 + (d[i] - '0'); ++i; any = true; }
+        if (!any) return 0;
+        vals[got++] = v;
+    }
+    if (got < 3 || i >= n) return 0;
+    w = vals[0]; h = vals[1]; maxval = (int)vals[2];
+    return i + 1; // single whitespace after maxval
+}
+
+DemTileStore::DemTileStore()
+    : base_(nullptr), mappedSize_(0), width_(0), height_(0), tileSize_(0), levels_(0), tileBytes_(0), budget_(256u << 20) {}
+
+DemTileStore::~DemTileStore() { close(); }
+
+void DemTileStore::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (base_) munmap(base_, mappedSize_);
+    base_ = nullptr; mappedSize_ = 0; width_ = height_ = 0; levels_ = 0;
+    lru_.clear(); resident_.clear();
+}
+
+int64_t DemTileStore::levelWidth(int level) const { return std::max<int64_t>(1, (width_ + ((int64_t)1 << level) - 1) >> level); }
+int64_t DemTileStore::levelHeight(int level) const { return std::max<int64_t>(1, (height_ + ((int64_t)1 << level) - 1) >> level); }
+
+void DemTileStore::layout() {
+    tileBytes_ = (size_t)tileSize_ * tileSize_ * sizeof(uint16_t);
+    uint64_t off = alignPage(sizeof(Header));
+    for (int l = 0; l < levels_; ++l) {
+        levelTilesX_[l] = (levelWidth(l) + tileSize_ - 1) / tileSize_;
+        levelTilesZ_[l] = (levelHeight(l) + tileSize_ - 1) / tileSize_;
+        levelOffset_[l] = off;
+        off += alignPage((size_t)(levelTilesX_[l] * levelTilesZ_[l]) * tileBytes_);
+    }
+    levelOffset_[levels_] = off; // total file size
+}
+
+bool DemTileStore::import(const std::string &srcPath, int64_t width, int64_t height, int tileSize) {
+    std::string pyrPath = srcPath + ".pyr";
+
+    // Reuse an existing pyramid when it is newer than the source
+    struct stat ss, ps;
+    if (stat(srcPath.c_str(), &ss) != 0) { std::cerr << "Failed to open heightmap: " << srcPath << std::endl; return false; }
+    if (stat(pyrPath.c_str(), &ps) == 0 && ps.st_mtime >= ss.st_mtime && open(pyrPath)) return true;
+
+    if (!buildPyramid(srcPath, pyrPath, width, height, tileSize)) return false;
+    return open(pyrPath);
+}
+
+bool DemTileStore::buildPyramid(const std::string &srcPath, const std::string &pyrPath, int64_t width, int64_t height, int tileSize) {
+    MappedFile src;
+    if (!mapRead(srcPath, src)) { std::cerr << "Failed to map heightmap: " << srcPath << std::endl; return false; }
+    madvise(src.data, src.size, MADV_SEQUENTIAL);
+
+    // Source format: binary PGM (big-endian when 16 bit) or little-endian 16-bit raw
+    int maxval = 65535; size_t dataOff = 0; bool bigEndian = false;
+    if (size_t off = parsePgm(src.data, src.size, width, height, maxval)) { dataOff = off; bigEndian = true; }
+    else {
+        int64_t n = (int64_t)(src.size / 2);
+        if (width <= 0) { width = (int64_t)std::llround(std::sqrt((double)n)); height = width; }
+        if (height <= 0 && width > 0) height = n / width;
+    }
+    int bps = maxval > 255 ? 2 : 1;
+    if (width <= 0 || height <= 0 || maxval < 1 || maxval > 65535 || dataOff + (size_t)(width * height * bps) > src.size) {
+        std::cerr << "Heightmap size mismatch: " << srcPath << std::endl; return false;
+    }
+    tileSize = std::max(64, tileSize - tileSize % 64); // keeps tiles page aligned
+
+    // Layout
+    width_ = width; height_ = height; tileSize_ = tileSize; levels_ = 1;
+    while (levels_ < 31 && (levelWidth(levels_ - 1) > tileSize_ || levelHeight(levels_ - 1) > tileSize_)) ++levels_;
+    layout();
+    size_t total = (size_t)levelOffset_[levels_];
+
+    // Create the output mapping (written to a temp file, renamed when
+    // complete; removed again on any failure)
+    std::string tmpPath = pyrPath + ".tmp";
+    MappedFile dst;
+    dst.fd = ::open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (dst.fd < 0) { std::cerr << "Failed to create " << tmpPath << std::endl; return false; }
+    auto fail = [&](const char* what, const std::string &path) { std::cerr << what << path << std::endl; ::unlink(tmpPath.c_str()); return false; };
+    if (ftruncate(dst.fd, (off_t)total) != 0) return fail("Failed to create ", tmpPath);
+    void* p = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, dst.fd, 0);
+    if (p == MAP_FAILED) return fail("Failed to map ", tmpPath);
+    dst.data = (unsigned char*)p; dst.size = total;
+
+    const int T = tileSize_;
+    auto tilePtr = [&](int l, int64_t tx, int64_t tz) {
+        return (uint16_t*)(dst.data + levelOffset_[l] + (size_t)(tz * levelTilesX_[l] + tx) * tileBytes_);
+    };
+    auto srcAt = [&](int64_t x, int64_t z) -> uint16_t {
+        const unsigned char* s = src.data + dataOff + (size_t)(z * width + x) * bps;
+        uint16_t v = bps == 1 ? s[0] : bigEndian ? (uint16_t)((s[0] << 8) | s[1]) : (uint16_t)(s[0] | (s[1] << 8));
+        return maxval == 65535 ? v : (uint16_t)std::min<int64_t>(65535, (int64_t)v * 65535 / maxval);
+    };
+
+    // Level 0: one band of tile rows at a time, releasing pages behind us
+    for (int64_t tz = 0; tz < levelTilesZ_[0]; ++tz) {
+        for (int r = 0; r < T; ++r) {
+            int64_t z = std::min(tz * T + r, height - 1);
+            for (int64_t tx = 0; tx < levelTilesX_[0]; ++tx) {
+                uint16_t* row = tilePtr(0, tx, tz) + (size_t)r * T;
+                for (int c = 0; c < T; ++c) row[c] = srcAt(std::min(tx * T + c, width - 1), z);
+            }
+        }
+        size_t bandBegin = dataOff + (size_t)(tz * T) * width * bps;
+        size_t bandEnd = std::min(src.size, dataOff + (size_t)std::min((tz + 1) * T, height) * width * bps);
+        size_t a = bandBegin & ~(kPage - 1);
+        if (bandEnd > a) madvise(src.data + a, bandEnd - a, MADV_DONTNEED);
+        unsigned char* band = (unsigned char*)tilePtr(0, 0, tz);
+        msync(band, (size_t)levelTilesX_[0] * tileBytes_, MS_ASYNC);
+        madvise(band, (size_t)levelTilesX_[0] * tileBytes_, MADV_DONTNEED);
+    }
+
+    // Mip levels: 2x2 box filter of the previous level (edges clamped)
+    for (int l = 1; l < levels_; ++l) {
+        int64_t pw = levelWidth(l - 1), ph = levelHeight(l - 1), lw = levelWidth(l), lh = levelHeight(l);
+        auto parent = [&](int64_t x, int64_t z) -> uint32_t {
+            x = std::min(x, pw - 1); z = std::min(z, ph - 1);
+            return tilePtr(l - 1, x / T, z / T)[(z % T) * T + (x % T)];
+        };
+        for (int64_t tz = 0; tz < levelTilesZ_[l]; ++tz) for (int64_t tx = 0; tx < levelTilesX_[l]; ++tx) {
+            uint16_t* t = tilePtr(l, tx, tz);
+            for (int r = 0; r < T; ++r) for (int c = 0; c < T; ++c) {
+                int64_t x = std::min(tx * T + c, lw - 1) * 2, z = std::min(tz * T + r, lh - 1) * 2;
+                uint32_t sum = parent(x, z) + parent(x + 1, z) + parent(x, z + 1) + parent(x + 1, z + 1);
+                t[(size_t)r * T + c] = (uint16_t)((sum + 2) / 4);
+            }
+        }
+    }
+
+    // Header last so a partial file never validates
+    Header hdr; std::memcpy(hdr.magic, kMagic, sizeof(kMagic));
+    hdr.width = (uint64_t)width_; hdr.height = (uint64_t)height_; hdr.tileSize = (uint32_t)tileSize_; hdr.levels = (uint32_t)levels_;
+    std::memcpy(dst.data, &hdr, sizeof(hdr));
+    if (msync(dst.data, dst.size, MS_SYNC) != 0 || std::rename(tmpPath.c_str(), pyrPath.c_str()) != 0) return fail("Failed to write ", pyrPath);
+    return true;
+}
+
+bool DemTileStore::open(const std::string &pyrPath) {
+    close();
+    MappedFile mf;
+    if (!mapRead(pyrPath, mf) || mf.size < sizeof(Header)) return false;
+    Header hdr; std::memcpy(&hdr, mf.data, sizeof(hdr));
+    if (std::memcmp(hdr.magic, kMagic, sizeof(kMagic)) != 0 || hdr.levels == 0 || hdr.levels > 31 || hdr.tileSize < 64) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    width_ = (int64_t)hdr.width; height_ = (int64_t)hdr.height; tileSize_ = (int)hdr.tileSize; levels_ = (int)hdr.levels;
+    layout();
+    if (levelOffset_[levels_] > mf.size) { width_ = height_ = 0; levels_ = 0; return false; }
+
+    // Take ownership of the mapping; the fd is no longer needed
+    base_ = mf.data; mappedSize_ = mf.size; mf.data = nullptr;
+    madvise(base_, mappedSize_, MADV_RANDOM);
+    return true;
+}
+
+void DemTileStore::setResidentBudget(size_t bytes) { std::lock_guard<std::mutex> lock(mutex_); budget_ = bytes; }
+size_t DemTileStore::residentBytes() const { std::lock_guard<std::mutex> lock(mutex_); return resident_.size() * tileBytes_; }
+
+const uint16_t* DemTileStore::tile(int level, int64_t tx, int64_t tz) {
+    uint64_t key = ((uint64_t)level << 58) | ((uint64_t)tx << 29) | (uint64_t)tz;
+    unsigned char* ptr = base_ + levelOffset_[level] + (size_t)(tz * levelTilesX_[level] + tx) * tileBytes_;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = resident_.find(key);
+    if (it != resident_.end()) { lru_.splice(lru_.begin(), lru_, it->second); return (const uint16_t*)ptr; }
+
+    // Page in and evict least recently used tiles over budget
+    madvise(ptr, tileBytes_, MADV_WILLNEED);
+    lru_.push_front(key); resident_[key] = lru_.begin();
+    while (lru_.size() > 1 && lru_.size() * tileBytes_ > budget_) {
+        uint64_t old = lru_.back(); lru_.pop_back(); resident_.erase(old);
+        int l = (int)(old >> 58); int64_t ox = (int64_t)((old >> 29) & 0x1fffffff), oz = (int64_t)(old & 0x1fffffff);
+        madvise(base_ + levelOffset_[l] + (size_t)(oz * levelTilesX_[l] + ox) * tileBytes_, tileBytes_, MADV_DONTNEED);
+    }
+    return (const uint16_t*)ptr;
+}
+
+uint16_t DemTileStore::at(int level, int64_t x, int64_t z) {
+    x = std::min(std::max<int64_t>(x, 0), levelWidth(level) - 1);
+    z = std::min(std::max<int64_t>(z, 0), levelHeight(level) - 1);
+    return tile(level, x / tileSize_, z / tileSize_)[(z % tileSize_) * tileSize_ + (x % tileSize_)];
+}
+
+float DemTileStore::sample(double sx, double sz) {
+    if (!base_) return 0.0f;
+    sx = std::min(std::max(sx, 0.0), (double)(width_ - 1));
+    sz = std::min(std::max(sz, 0.0), (double)(height_ - 1));
+    int64_t x0 = (int64_t)sx, z0 = (int64_t)sz;
+    float fx = (float)(sx - x0), fz = (float)(sz - z0);
+    float h00 = at(0, x0, z0), h10 = at(0, x0 + 1, z0), h01 = at(0, x0, z0 + 1), h11 = at(0, x0 + 1, z0 + 1);
+    float a = h00 + (h10 - h00) * fx, b = h01 + (h11 - h01) * fx;
+    return (a + (b - a) * fz) * (1.0f / 65535.0f);
+}
+
+void DemTileStore::readRegion(int level, int64_t x0, int64_t z0, int w, int h, float* out) {
+    if (!base_) { std::fill(out, out + (size_t)w * h, 0.0f); return; }
+    level = std::min(std::max(level, 0), levels_ - 1);
+    int64_t lw = levelWidth(level), lh = levelHeight(level); const int T = tileSize_;
+    for (int j = 0; j < h; ++j) {
+        int64_t z = std::min(std::max<int64_t>(z0 + j, 0), lh - 1);
+        float* row = out + (size_t)j * w;
+        int i = 0;
+        while (i < w) {
+            int64_t x = std::min(std::max<int64_t>(x0 + i, 0), lw - 1);
+            const uint16_t* t = tile(level, x / T, z / T) + (z % T) * T;
+            // Consume the run of output samples that stays inside this tile
+            int64_t tileEnd = (x / T + 1) * T;
+            do {
+                row[i++] = t[x % T] * (1.0f / 65535.0f);
+                x = std::min(std::max<int64_t>(x0 + i, 0), lw - 1);
+            } while (i < w && x < tileEnd && x >= tileEnd - T);
+        }
+    }
+}
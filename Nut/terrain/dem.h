@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Out-of-core 16-bit elevation data (DEM).
+//
+// import() converts a binary PGM ("P5", 8 or 16 bit) or a headerless
+// little-endian 16-bit .raw file into a tiled, mip-pyramided cache file
+// next to it. Both files are memory-mapped, so neither has to fit in RAM.
+// Readers page tiles in on demand; a resident-set budget (bytes) bounds how
+// many tiles stay mapped in, least recently used tiles are dropped with
+// madvise(MADV_DONTNEED) and simply fault back in from disk when touched.
+//
+// Sample coordinates are in level-0 samples; level L holds every 2^L-th
+// sample (2x2 box filtered). Heights are returned normalized to [0, 1].
+class DemTileStore {
+public:
+    DemTileStore();
+    ~DemTileStore();
+
+    DemTileStore(const DemTileStore&) = delete;
+    DemTileStore& operator=(const DemTileStore&) = delete;
+
+    // Build (or reuse, when newer than the source) `<srcPath>.pyr` and open it.
+    // width/height are required for .raw files unless the data is square.
+    bool import(const std::string &srcPath, int64_t width = 0, int64_t height = 0, int tileSize = 256);
+
+    // Open an existing pyramid file.
+    bool open(const std::string &pyrPath);
+    void close();
+    bool isOpen() const { return base_ != nullptr; }
+
+    int64_t width() const { return width_; }
+    int64_t height() const { return height_; }
+    int levels() const { return levels_; }
+    int tileSize() const { return tileSize_; }
+    int64_t levelWidth(int level) const;
+    int64_t levelHeight(int level) const;
+
+    // Bilinear height at fractional level-0 sample coords (clamped to the edges).
+    float sample(double sx, double sz);
+
+    // Copy a w x h block of level `level` starting at (x0, z0) into out
+    // (row-major, clamped to the edges). Walks tile by tile.
+    void readRegion(int level, int64_t x0, int64_t z0, int w, int h, float* out);
+
+    // Resident-set budget in bytes (default 256 MB) and current usage.
+    void setResidentBudget(size_t bytes);
+    size_t residentBudget() const { return budget_; }
+    size_t residentBytes() const;
+
+private:
+    struct Header;
+    const uint16_t* tile(int level, int64_t tx, int64_t tz); // touches the LRU
+    uint16_t at(int level, int64_t x, int64_t z);
+    bool buildPyramid(const std::string &srcPath, const std::string &pyrPath, int64_t width, int64_t height, int tileSize);
+    void layout(); // compute per-level offsets from width_/height_/tileSize_
+
+    // Mapping
+    unsigned char* base_;
+    size_t mappedSize_;
+    int64_t width_, height_;
+    int tileSize_, levels_;
+    size_t tileBytes_;
+    uint64_t levelOffset_[32];
+    int64_t levelTilesX_[32];
+    int64_t levelTilesZ_[32];
+
+    // Resident-set tracking (tile key -> LRU position)
+    mutable std::mutex mutex_;
+    size_t budget_;
+    std::list<uint64_t> lru_;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> resident_;
+};
@@ -0,0 +1,165 @@
+#include "height_pyramid.h"
+#include "../core/job_pool.h"
+
+#include <algorithm>
+#include <limits>
+
+HeightPyramid::Level HeightPyramid::makeLevel(int n) {
+    const float inf = std::numeric_limits<float>::infinity();
+    size_t g = (size_t)((n + 1) >> 1);
+    return Level{n, std::vector<Bounds>(g * g * 4, Bounds{inf, -inf})};
+}
+
+void HeightPyramid::build(const Heightfield &h) {
+    levels_.clear();
+    int cells = h.size() - 1;
+    if (cells < 1) return;
+
+    // Level 0 straight from the 3x3 samples of each 2x2-cell block
+    int n = (cells + 1) / 2;
+    levels_.push_back(makeLevel(n));
+    Level &l0 = levels_.back();
+    JobPool::instance().parallelFor(0, (size_t)n, 16, [&](size_t zb, size_t ze) {
+        for (int bz = (int)zb; bz < (int)ze; ++bz) for (int bx = 0; bx < n; ++bx) {
+            float mn, mx;
+            h.minMax(bx * 2, bz * 2, std::min(bx * 2 + 2, cells), std::min(bz * 2 + 2, cells), mn, mx);
+            l0.b[l0.index(bx, bz)] = Bounds{mn, mx};
+        }
+    });
+
+    // Reduce each sibling quad to its parent until a single root; padding
+    // children are empty and drop out of the min/max
+    while (n > 1) {
+        int cn = (n + 1) / 2;
+        levels_.push_back(makeLevel(cn));
+        const Level &p = levels_[levels_.size() - 2]; Level &c = levels_.back();
+        for (int bz = 0; bz < cn; ++bz) for (int bx = 0; bx < cn; ++bx) {
+            const Bounds *q = &p.b[((size_t)bz * cn + bx) << 2];
+            c.b[c.index(bx, bz)] = Bounds{std::min(std::min(q[0].mn, q[1].mn), std::min(q[2].mn, q[3].mn)),
+                                          std::max(std::max(q[0].mx, q[1].mx), std::max(q[2].mx, q[3].mx))};
+        }
+        n = cn;
+    }
+}
+
+size_t HeightPyramid::storageBytes() const {
+    size_t bytes = 0;
+    for (const Level &l : levels_) bytes += l.b.size() * sizeof(Bounds);
+    return bytes;
+}
+
+namespace {
+
+// Exact test of the ray against the two triangles of cell (cx, cz) over
+// [a, b]; x/z in grid samples
+bool cellHit(const Heightfield &h, int cells, const glm::vec3 &o, const glm::vec3 &d, int cx, int cz, float a, float b, float &tHit) {
+    if (cx < 0 || cz < 0 || cx >= cells || cz >= cells) return false;
+    const float *p = h.data() + h.index(cx, cz);
+    ptrdiff_t sx = h.stepX(cx, 1), sz = h.stepZ(cz, 1);
+    float h00 = p[0], h10 = p[sx], h01 = p[sz], h11 = p[sz + sx];
+    // Diagonal fx == fz splits the cell into (tl, bl, br) below and (tl, br, tr) above
+    float dd = d.x - d.z, td = dd != 0.0f ? ((float)(cx - cz) - (o.x - o.z)) / dd : b;
+    float ts[3] = {a, b, b}; int n = 1;
+    if (td > a && td < b) ts[n++] = td;
+    ts[n] = b;
+    for (int i = 0; i < n; ++i) {
+        float s0 = ts[i], s1 = ts[i + 1];
+        float tm = 0.5f * (s0 + s1), fxm = o.x + d.x * tm - cx, fzm = o.z + d.z * tm - cz;
+        float ddx, ddz;
+        if (fzm >= fxm) { ddx = h11 - h01; ddz = h01 - h00; } else { ddx = h10 - h00; ddz = h11 - h10; }
+        // f(t) = ray height - plane height, linear within one triangle
+        auto f = [&](float t) { return o.y + d.y * t - (h00 + ddx * (o.x + d.x * t - cx) + ddz * (o.z + d.z * t - cz)); };
+        float f0 = f(s0), f1 = f(s1);
+        if (f0 <= 0.0f) { tHit = s0; return true; }
+        if (f1 <= 0.0f) { tHit = s0 + (s1 - s0) * (f0 / (f0 - f1)); return true; }
+    }
+    return false;
+}
+
+} // namespace
+
+bool HeightPyramid::intersect(const Heightfield &h, const glm::vec3 &o, const glm::vec3 &d, float t0, float t1, float &tHit) const {
+    if (empty()) return false;
+    const float inf = std::numeric_limits<float>::infinity();
+    const int cells = h.size() - 1;
+    const float invX = d.x != 0.0f ? 1.0f / d.x : inf, invZ = d.z != 0.0f ? 1.0f / d.z : inf;
+
+    // Clip to the grid footprint [0, cells] in x and z
+    for (int axis = 0; axis < 3; axis += 2) {
+        if (d[axis] == 0.0f) { if (o[axis] < 0.0f || o[axis] > (float)cells) return false; continue; }
+        float inv = axis == 0 ? invX : invZ;
+        float ta = (0.0f - o[axis]) * inv, tb = ((float)cells - o[axis]) * inv;
+        if (ta > tb) std::swap(ta, tb);
+        t0 = std::max(t0, ta); t1 = std::min(t1, tb);
+    }
+    // ... and to the part of the ray inside the terrain's height range
+    const Bounds &root = node(levels() - 1, 0, 0);
+    if (d.y < 0.0f) { t0 = std::max(t0, (root.mx - o.y) / d.y); t1 = std::min(t1, std::max((root.mn - o.y) / d.y, t0)); }
+    else if (o.y > root.mx) return false;
+    if (!(t0 <= t1)) return false;
+
+    // Walk front to back over nodes at shift s (s = 0 is a single cell,
+    // s = l + 1 a level-l node), starting at the smallest node holding the
+    // whole segment. A node the ray passes above is stepped over like a DDA
+    // cell; otherwise descend into the child under the entry point. A step
+    // that stays inside the parent moves on to the sibling without going
+    // back through the parent; leaving it climbs one level.
+    auto cellOf = [&](float g) { return std::min(std::max((int)g, 0), cells - 1); };  // truncation == floor once clamped at 0
+    int ax = cellOf(o.x + d.x * t0), az = cellOf(o.z + d.z * t0), bx = cellOf(o.x + d.x * t1), bz = cellOf(o.z + d.z * t1);
+    int top = 1;
+    while (top < levels() && ((ax ^ bx) | (az ^ bz)) >> top) ++top;
+    const int stepX = d.x > 0.0f ? 1 : -1, stepZ = d.z > 0.0f ? 1 : -1;
+    const int farX = d.x > 0.0f, farZ = d.z > 0.0f;
+
+    // Node addresses along the ray follow from its geometry alone, so the
+    // next node and the whole path below a node being entered are requested
+    // up front instead of missing one level at a time
+    auto prefetchCell = [&](int cx, int cz) {
+        if ((unsigned)cx >= (unsigned)cells || (unsigned)cz >= (unsigned)cells) return;
+        const float *p = h.data() + h.index(cx, cz);
+        __builtin_prefetch(p); __builtin_prefetch(p + h.stepZ(cz, 1));
+    };
+    auto prefetchNode = [&](int shift, int x, int z) {
+        const Level &l = levels_[shift - 1];
+        if ((unsigned)x < (unsigned)l.n && (unsigned)z < (unsigned)l.n) __builtin_prefetch(&l.b[l.index(x, z)]);
+    };
+
+    int s = top, nx = ax >> s, nz = az >> s;
+    float t = t0;
+    bool entering = true;  // no descent yet since the last step
+    for (;;) {
+        float tx = d.x != 0.0f ? ((float)((nx + farX) << s) - o.x) * invX : inf;
+        float tz = d.z != 0.0f ? ((float)((nz + farZ) << s) - o.z) * invZ : inf;
+        float te = std::max(std::min(std::min(tx, tz), t1), t);
+        int qx = nx, qz = nz;  // next node along the ray at this level
+        if (tx <= tz) qx += stepX; else qz += stepZ;
+        if (s == 0) {
+            prefetchCell(qx, qz);
+            if (cellHit(h, cells, o, d, nx, nz, t, te, tHit)) return true;
+        } else {
+            const Level &l = levels_[s - 1];
+            if ((unsigned)nx >= (unsigned)l.n || (unsigned)nz >= (unsigned)l.n) return false;  // stepped off the grid
+            prefetchNode(s, qx, qz);
+            const Bounds &b = l.b[l.index(nx, nz)];
+            float ya = o.y + d.y * t, yb = o.y + d.y * te;
+            if (ya <= b.mn) { tHit = t; return true; }  // enters below the lowest point
+            if (std::min(ya, yb) <= b.mx) {              // not entirely above: descend
+                if (entering) {
+                    int cx = cellOf(o.x + d.x * t), cz = cellOf(o.z + d.z * t);
+                    for (int k = s - 1; k > 0; --k) prefetchNode(k, cx >> k, cz >> k);
+                    prefetchCell(cx, cz);
+                    entering = false;
+                }
+                --s;
+                float mx = (float)((2 * nx + 1) << s), mz = (float)((2 * nz + 1) << s);
+                nx = 2 * nx + (o.x + d.x * t >= mx); nz = 2 * nz + (o.z + d.z * t >= mz);
+                continue;
+            }
+        }
+        if (te >= t1) return false;
+        int up = s < top && ((nx ^ qx) | (nz ^ qz)) >> 1;  // left the parent: climb one level
+        s += up; qx >>= up; qz >>= up;
+        if (s == top && (qx != ax >> top || qz != az >> top)) return false;
+        nx = qx; nz = qz; t = te; entering = true;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+#include "heightfield.h"
+
+// Hierarchical min/max bounds over a heightfield's cells, for ray queries.
+// Level 0 node (bx, bz) bounds the 2x2 cells [2bx, 2bx + 2) x [2bz, 2bz + 2);
+// each level above halves the node count per side up to a single root.
+// Nodes past the grid edge are empty (min = +inf, max = -inf). Each level
+// stores the four children of a parent next to each other, so a descent
+// touches one cache line per level.
+class HeightPyramid {
+public:
+    struct Bounds { float mn, mx; };
+
+    void build(const Heightfield &h);
+    bool empty() const { return levels_.empty(); }
+    int levels() const { return (int)levels_.size(); }
+    size_t storageBytes() const;
+
+    int nodesPerSide(int level) const { return levels_[level].n; }
+    const Bounds& node(int level, int bx, int bz) const { const Level &l = levels_[level]; return l.b[l.index(bx, bz)]; }
+
+    // First t in [t0, t1] where the ray is at or below the triangulated
+    // surface of h (same (tl, bl, br) / (tl, br, tr) split as the terrain
+    // mesh). The ray is in grid space: x/z in samples, y in height units.
+    // Nodes the ray passes entirely above are skipped; a node the ray enters
+    // below its minimum is a hit at the entry point. Leaves are tested
+    // exactly against both triangles of each cell.
+    bool intersect(const Heightfield &h, const glm::vec3 &o, const glm::vec3 &d, float t0, float t1, float &tHit) const;
+
+private:
+    struct Level {
+        int n;                  // nodes per side
+        std::vector<Bounds> b;  // sibling quads, row-major over parents
+        size_t index(int bx, int bz) const { return (((size_t)(bz >> 1) * ((n + 1) >> 1) + (size_t)(bx >> 1)) << 2) | (size_t)((bz & 1) << 1) | (size_t)(bx & 1); }
+    };
+    static Level makeLevel(int n);
+    std::vector<Level> levels_;
+};
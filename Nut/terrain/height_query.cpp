@@ -0,0 +1,209 @@
+#include "height_query.h"
+#include "../core/job_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Locate the grid cell under (wx, wz): cell corner (x0, z0) and the fractional
+// position inside it, clamped to the grid
+static inline void locate(const TerrainGrid &g, float wx, float wz, int &x0, int &z0, float &fx, float &fz) {
+    int N = g.heights.size();
+    float gx = std::min(std::max((wx - g.originX) / g.spacing, 0.0f), (float)(N - 1));
+    float gz = std::min(std::max((wz - g.originZ) / g.spacing, 0.0f), (float)(N - 1));
+    x0 = std::min((int)gx, N - 2); z0 = std::min((int)gz, N - 2);
+    fx = gx - x0; fz = gz - z0;
+}
+
+bool TerrainGrid::contains(float wx, float wz) const {
+    float extent = (heights.size() - 1) * spacing;
+    return wx >= originX && wz >= originZ && wx <= originX + extent && wz <= originZ + extent;
+}
+
+float TerrainGrid::height(float wx, float wz) const {
+    if (heights.size() < 2) return heights.empty() ? 0.0f : heights.at(0, 0);
+    int x0, z0; float fx, fz; locate(*this, wx, wz, x0, z0, fx, fz);
+    float h00 = heights.at(x0, z0), h11 = heights.at(x0 + 1, z0 + 1);
+    if (fz >= fx) { float h01 = heights.at(x0, z0 + 1); return h00 + (h11 - h01) * fx + (h01 - h00) * fz; } // (tl, bl, br)
+    float h10 = heights.at(x0 + 1, z0); return h00 + (h10 - h00) * fx + (h11 - h10) * fz;                   // (tl, br, tr)
+}
+
+glm::vec3 TerrainGrid::normal(float wx, float wz) const {
+    if (heights.size() < 2) return glm::vec3(0.0f, 1.0f, 0.0f);
+    int x0, z0; float fx, fz; locate(*this, wx, wz, x0, z0, fx, fz);
+    float h00 = heights.at(x0, z0), h11 = heights.at(x0 + 1, z0 + 1);
+    float ddx, ddz; // height deltas per cell along x and z on the triangle's plane
+    if (fz >= fx) { float h01 = heights.at(x0, z0 + 1); ddx = h11 - h01; ddz = h01 - h00; }
+    else { float h10 = heights.at(x0 + 1, z0); ddx = h10 - h00; ddz = h11 - h10; }
+    return glm::normalize(glm::vec3(-ddx, spacing, -ddz));
+}
+
+void TerrainGrid::queryBatch(const float* xs, const float* zs, size_t count, float* out,
+                             float* nx, float* ny, float* nz) const {
+    const int N = heights.size();
+    if (N < 2) {
+        for (size_t i = 0; i < count; ++i) { out[i] = N ? heights.at(0, 0) : 0.0f; if (nx) { nx[i] = 0.0f; ny[i] = 1.0f; nz[i] = 0.0f; } }
+        return;
+    }
+    const float inv = 1.0f / spacing, maxG = (float)(N - 1);
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 vox = _mm_set1_ps(originX), voz = _mm_set1_ps(originZ), vinv = _mm_set1_ps(inv);
+    const __m128 vzero = _mm_setzero_ps(), vmax = _mm_set1_ps(maxG), vs = _mm_set1_ps(spacing);
+    const __m128i vlast = _mm_set1_epi32(N - 2);
+    alignas(16) int ix[4], iz[4];
+    alignas(16) float h00[4], h10[4], h01[4], h11[4];
+    const float* base = heights.data();
+    for (; i + 4 <= count; i += 4) {
+        // Grid coords, clamped; truncation == floor since they are >= 0
+        __m128 gx = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(xs + i), vox), vinv), vzero), vmax);
+        __m128 gz = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(zs + i), voz), vinv), vzero), vmax);
+        __m128i cx = _mm_cvttps_epi32(gx), cz = _mm_cvttps_epi32(gz);
+        // min(c, N - 2) without SSE4.1
+        __m128i gtx = _mm_cmpgt_epi32(cx, vlast), gtz = _mm_cmpgt_epi32(cz, vlast);
+        cx = _mm_or_si128(_mm_and_si128(gtx, vlast), _mm_andnot_si128(gtx, cx));
+        cz = _mm_or_si128(_mm_and_si128(gtz, vlast), _mm_andnot_si128(gtz, cz));
+        __m128 fx = _mm_sub_ps(gx, _mm_cvtepi32_ps(cx)), fz = _mm_sub_ps(gz, _mm_cvtepi32_ps(cz));
+        _mm_store_si128((__m128i*)ix, cx); _mm_store_si128((__m128i*)iz, cz);
+
+        // Corner gathers (scalar; layout-aware)
+        for (int k = 0; k < 4; ++k) {
+            const float* p = base + heights.index(ix[k], iz[k]);
+            ptrdiff_t dx = heights.stepX(ix[k], 1), dz = heights.stepZ(iz[k], 1);
+            h00[k] = p[0]; h10[k] = p[dx]; h01[k] = p[dz]; h11[k] = p[dz + dx];
+        }
+        __m128 a = _mm_load_ps(h00), b = _mm_load_ps(h10), c = _mm_load_ps(h01), d = _mm_load_ps(h11);
+
+        // Triangle select: (tl, bl, br) where fz >= fx, else (tl, br, tr)
+        __m128 lower = _mm_cmpge_ps(fz, fx);
+        __m128 ddx = _mm_or_ps(_mm_and_ps(lower, _mm_sub_ps(d, c)), _mm_andnot_ps(lower, _mm_sub_ps(b, a)));
+        __m128 ddz = _mm_or_ps(_mm_and_ps(lower, _mm_sub_ps(c, a)), _mm_andnot_ps(lower, _mm_sub_ps(d, b)));
+        _mm_storeu_ps(out + i, _mm_add_ps(a, _mm_add_ps(_mm_mul_ps(ddx, fx), _mm_mul_ps(ddz, fz))));
+
+        if (nx) {
+            __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ddx, ddx), _mm_mul_ps(vs, vs)), _mm_mul_ps(ddz, ddz));
+            __m128 r = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(len2));
+            _mm_storeu_ps(nx + i, _mm_mul_ps(_mm_sub_ps(vzero, ddx), r));
+            _mm_storeu_ps(ny + i, _mm_mul_ps(vs, r));
+            _mm_storeu_ps(nz + i, _mm_mul_ps(_mm_sub_ps(vzero, ddz), r));
+        }
+    }
+#endif
+    // Scalar tail (or everything without SSE2)
+    for (; i < count; ++i) {
+        out[i] = height(xs[i], zs[i]);
+        if (nx) { glm::vec3 n = normal(xs[i], zs[i]); nx[i] = n.x; ny[i] = n.y; nz[i] = n.z; }
+    }
+}
+
+bool TerrainGrid::raycast(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, RayHit &hit) const {
+    float len = glm::length(dir);
+    if (len == 0.0f || heights.size() < 2) return false;
+    // Grid space keeps t in world units: x/z scaled to samples, y untouched
+    glm::vec3 d = dir / len;
+    glm::vec3 o((origin.x - originX) / spacing, origin.y, (origin.z - originZ) / spacing);
+    float t;
+    if (!pyramid.intersect(heights, o, glm::vec3(d.x / spacing, d.y, d.z / spacing), 0.0f, maxT, t)) return false;
+    hit.t = t; hit.position = origin + d * t;
+    hit.normal = normal(hit.position.x, hit.position.z);
+    return true;
+}
+
+bool TerrainGrid::lineOfSight(const glm::vec3 &from, const glm::vec3 &to) const {
+    RayHit hit;
+    return !raycast(from, to - from, glm::length(to - from), hit);
+}
+
+void HeightQuery::publish(std::shared_ptr<const TerrainGrid> grid) { std::atomic_store(&grid_, std::move(grid)); }
+std::shared_ptr<const TerrainGrid> HeightQuery::snapshot() const { return std::atomic_load(&grid_); }
+
+float HeightQuery::height(float wx, float wz) const {
+    auto g = snapshot();
+    return g ? g->height(wx, wz) : 0.0f;
+}
+
+glm::vec3 HeightQuery::normal(float wx, float wz) const {
+    auto g = snapshot();
+    return g ? g->normal(wx, wz) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+void HeightQuery::queryBatch(const float* xs, const float* zs, size_t count, float* heights,
+                             float* nx, float* ny, float* nz) const {
+    std::shared_ptr<const TerrainGrid> g = snapshot();
+    if (!g) {
+        std::fill(heights, heights + count, 0.0f);
+        if (nx) { std::fill(nx, nx + count, 0.0f); std::fill(ny, ny + count, 1.0f); std::fill(nz, nz + count, 0.0f); }
+        return;
+    }
+    // Chunks stay multiples of 4 so every worker runs the SIMD path
+    JobPool::instance().parallelFor(0, (count + 3) / 4, 1024, [&](size_t b, size_t e) {
+        size_t first = b * 4, last = std::min(count, e * 4);
+        g->queryBatch(xs + first, zs + first, last - first, heights + first,
+                      nx ? nx + first : nullptr, ny ? ny + first : nullptr, nz ? nz + first : nullptr);
+    });
+}
+
+bool HeightQuery::raycast(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, RayHit &hit) const {
+    std::shared_ptr<const TerrainGrid> g = snapshot();
+    return g && g->raycast(origin, dir, maxT, hit);
+}
+
+// Spread the low 16 bits of v to the even bit positions
+static inline uint32_t part1By1(uint32_t v) {
+    v &= 0xffff;
+    v = (v | (v << 8)) & 0x00ff00ff; v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333; v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+void HeightQuery::lineOfSightBatch(const glm::vec3* from, const glm::vec3* to, size_t count, uint64_t* bits) const {
+    size_t words = (count + 63) / 64;
+    std::shared_ptr<const TerrainGrid> g = snapshot();
+    if (!g || g->pyramid.empty()) { std::fill(bits, bits + words, ~0ull); if (count % 64) bits[words - 1] = (1ull << (count % 64)) - 1; return; }
+
+    // Z-order by segment midpoint so neighbouring work shares pyramid nodes and height rows
+    std::vector<std::pair<uint32_t, uint32_t>> order(count);
+    float inv = 1.0f / g->spacing;
+    for (size_t i = 0; i < count; ++i) {
+        float mx = (0.5f * (from[i].x + to[i].x) - g->originX) * inv, mz = (0.5f * (from[i].z + to[i].z) - g->originZ) * inv;
+        uint32_t qx = (uint32_t)std::min(std::max(mx, 0.0f), 65535.0f), qz = (uint32_t)std::min(std::max(mz, 0.0f), 65535.0f);
+        order[i] = std::make_pair(part1By1(qx) | (part1By1(qz) << 1), (uint32_t)i);
+    }
+    std::sort(order.begin(), order.end());
+
+    // Segments entirely above the highest point are clear without a traversal
+    const float top = g->pyramid.node(g->pyramid.levels() - 1, 0, 0).mx;
+    std::vector<uint8_t> visible(count);
+    JobPool::instance().parallelFor(0, count, 256, [&](size_t b, size_t e) {
+        size_t i = b;
+#if defined(__SSE2__)
+        const __m128 vtop = _mm_set1_ps(top);
+        for (; i + 4 <= e; i += 4) {
+            uint32_t k[4] = {order[i].second, order[i + 1].second, order[i + 2].second, order[i + 3].second};
+            __m128 y0 = _mm_set_ps(from[k[3]].y, from[k[2]].y, from[k[1]].y, from[k[0]].y);
+            __m128 y1 = _mm_set_ps(to[k[3]].y, to[k[2]].y, to[k[1]].y, to[k[0]].y);
+            int above = _mm_movemask_ps(_mm_cmpgt_ps(_mm_min_ps(y0, y1), vtop));
+            for (int l = 0; l < 4; ++l) visible[k[l]] = (above >> l) & 1 ? 1 : (uint8_t)g->lineOfSight(from[k[l]], to[k[l]]);
+        }
+#endif
+        for (; i < e; ++i) {
+            uint32_t idx = order[i].second;
+            visible[idx] = std::min(from[idx].y, to[idx].y) > top ? 1 : (uint8_t)g->lineOfSight(from[idx], to[idx]);
+        }
+    });
+
+    // Pack to the bitmask, one word per 64 segments
+    JobPool::instance().parallelFor(0, words, 256, [&](size_t b, size_t e) {
+        for (size_t w = b; w < e; ++w) {
+            uint64_t m = 0;
+            for (size_t j = 0, n = std::min<size_t>(64, count - w * 64); j < n; ++j) m |= (uint64_t)visible[w * 64 + j] << j;
+            bits[w] = m;
+        }
+    });
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "heightfield.h"
+#include "height_pyramid.h"
+
+// Result of a terrain raycast
+struct RayHit {
+    float t = 0.0f;          // distance along the (normalized) ray
+    glm::vec3 position{0.0f};
+    glm::vec3 normal{0.0f, 1.0f, 0.0f};
+};
+
+// Immutable height grid plus its world placement: sample (x, z) sits at
+// (originX + x * spacing, heights(x, z), originZ + z * spacing).
+struct TerrainGrid {
+    Heightfield heights;
+    float originX = 0.0f, originZ = 0.0f, spacing = 1.0f;
+    HeightPyramid pyramid;   // min/max bounds for raycast(); see buildPyramid()
+
+    // True when (wx, wz) lies over the grid
+    bool contains(float wx, float wz) const;
+
+    // Height and upward unit normal of the drawn surface. Uses the same
+    // triangle split as the terrain index buffer ((tl, bl, br), (tl, br, tr)),
+    // so results match the rasterized mesh exactly. Clamped outside the grid.
+    float height(float wx, float wz) const;
+    glm::vec3 normal(float wx, float wz) const;
+
+    // Batched form over structure-of-arrays input: heights[i] (and, when nx
+    // is non-null, the unit normal in nx/ny/nz[i]) for (xs[i], zs[i]).
+    // SSE2-vectorized four points at a time, single-threaded.
+    void queryBatch(const float* xs, const float* zs, size_t count, float* heights,
+                    float* nx = nullptr, float* ny = nullptr, float* nz = nullptr) const;
+
+    // (Re)build the min/max pyramid after filling heights; required by raycast()
+    void buildPyramid() { pyramid.build(heights); }
+
+    // First intersection of origin + t * dir (t in [0, maxT]) with the drawn
+    // surface; a ray starting below it hits at t = 0. False if it misses or
+    // leaves the grid first.
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, RayHit &hit) const;
+
+    // True when the segment from -> to does not touch the surface (same
+    // traversal as raycast; an endpoint below the surface blocks)
+    bool lineOfSight(const glm::vec3 &from, const glm::vec3 &to) const;
+};
+
+// Query service over the currently drawn terrain. publish() swaps in a new
+// grid atomically; a reader that took snapshot() keeps a consistent grid
+// for as long as it holds it, so queries stay valid while a regeneration
+// (CPU, GPU readback or DEM re-center) is in flight or being published.
+class HeightQuery {
+public:
+    void publish(std::shared_ptr<const TerrainGrid> grid);
+    std::shared_ptr<const TerrainGrid> snapshot() const;
+    bool valid() const { return (bool)snapshot(); }
+
+    // Convenience single queries against the latest grid (O(1))
+    float height(float wx, float wz) const;
+    glm::vec3 normal(float wx, float wz) const;
+
+    // Batched SoA queries for many entities at once, split across JobPool.
+    // All points are answered from one snapshot. Outside the grid results clamp to its edge.
+    void queryBatch(const float* xs, const float* zs, size_t count, float* heights,
+                    float* nx = nullptr, float* ny = nullptr, float* nz = nullptr) const;
+
+    // Raycast against the latest grid (picking, visibility)
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, RayHit &hit) const;
+
+    // Visibility of many (from[i], to[i]) segments against one snapshot.
+    // Bit i of visibleBits ((count + 63) / 64 words) is set when segment i
+    // is clear. Segments are sorted by midpoint along a Z-order curve and
+    // run across JobPool; results equal lineOfSight() per segment.
+    void lineOfSightBatch(const glm::vec3* from, const glm::vec3* to, size_t count, uint64_t* visibleBits) const;
+
+private:
+    std::shared_ptr<const TerrainGrid> grid_;
+};
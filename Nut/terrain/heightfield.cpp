@@ -0,0 +1,79 @@
+#include "heightfield.h"
+
+#include <algorithm>
+#include <cstring>
+
+void Heightfield::resize(int size, HeightLayout layout) {
+    size_ = std::max(size, 0); layout_ = layout;
+    tilesX_ = (size_ + TILE - 1) / TILE;
+    size_t n = layout_ == HeightLayout::RowMajor ? (size_t)size_ * size_ : (size_t)tilesX_ * tilesX_ * TILE * TILE;
+    data_.assign(n, 0.0f);
+}
+
+float Heightfield::atClamped(int x, int z) const {
+    x = std::min(std::max(x, 0), size_ - 1); z = std::min(std::max(z, 0), size_ - 1);
+    return at(x, z);
+}
+
+float Heightfield::bilinear(float gx, float gz) const {
+    if (size_ < 2) return size_ ? data_[0] : 0.0f;
+    gx = std::min(std::max(gx, 0.0f), (float)(size_ - 1)); gz = std::min(std::max(gz, 0.0f), (float)(size_ - 1));
+    int x0 = std::min((int)gx, size_ - 2), z0 = std::min((int)gz, size_ - 2);
+    float fx = gx - x0, fz = gz - z0;
+    const float* p = data_.data() + index(x0, z0); ptrdiff_t dx = stepX(x0, 1), dz = stepZ(z0, 1);
+    float h00 = p[0], h10 = p[dx], h01 = p[dz], h11 = p[dz + dx];
+    float a = h00 + (h10 - h00) * fx, b = h01 + (h11 - h01) * fx;
+    return a + (b - a) * fz;
+}
+
+void Heightfield::stencil3x3(int x, int z, float out[9]) const {
+    // Interior fast path avoids per-sample clamping
+    if (x > 0 && z > 0 && x < size_ - 1 && z < size_ - 1) {
+        const float* c = data_.data() + index(x, z);
+        ptrdiff_t xs[3] = { stepX(x, -1), 0, stepX(x, 1) }, zs[3] = { stepZ(z, -1), 0, stepZ(z, 1) };
+        for (int j = 0; j < 3; ++j) for (int i = 0; i < 3; ++i) out[j * 3 + i] = c[zs[j] + xs[i]];
+        return;
+    }
+    for (int dz = -1; dz <= 1; ++dz) for (int dx = -1; dx <= 1; ++dx) out[(dz + 1) * 3 + dx + 1] = atClamped(x + dx, z + dz);
+}
+
+void Heightfield::minMax(int x0, int z0, int x1, int z1, float &mn, float &mx) const {
+    x0 = std::max(x0, 0); z0 = std::max(z0, 0); x1 = std::min(x1, size_ - 1); z1 = std::min(z1, size_ - 1);
+    mn = 3.402823e38f; mx = -3.402823e38f;
+    if (x0 > x1 || z0 > z1) return;
+    if (layout_ == HeightLayout::RowMajor) {
+        for (int z = z0; z <= z1; ++z) {
+            const float* r = data_.data() + (size_t)z * size_;
+            for (int x = x0; x <= x1; ++x) { mn = std::min(mn, r[x]); mx = std::max(mx, r[x]); }
+        }
+        return;
+    }
+    // Tiled: walk whole tiles, clipping the first/last row and column of tiles
+    for (int tz = z0 / TILE; tz <= z1 / TILE; ++tz) for (int tx = x0 / TILE; tx <= x1 / TILE; ++tx) {
+        const float* t = data_.data() + (((size_t)tz * tilesX_ + tx) << 6);
+        int ra = std::max(z0 - tz * TILE, 0), rb = std::min(z1 - tz * TILE, TILE - 1);
+        int ca = std::max(x0 - tx * TILE, 0), cb = std::min(x1 - tx * TILE, TILE - 1);
+        for (int r = ra; r <= rb; ++r) for (int c = ca; c <= cb; ++c) { float v = t[r * TILE + c]; mn = std::min(mn, v); mx = std::max(mx, v); }
+    }
+}
+
+void Heightfield::copyRow(int z, float* out) const {
+    if (layout_ == HeightLayout::RowMajor) { std::memcpy(out, data_.data() + (size_t)z * size_, (size_t)size_ * sizeof(float)); return; }
+    const float* t = data_.data() + (((size_t)(z >> 3) * tilesX_) << 6) + (size_t)((z & 7) << 3);
+    for (int tx = 0; tx < tilesX_; ++tx, t += TILE * TILE) {
+        int n = std::min(TILE, size_ - tx * TILE);
+        std::memcpy(out + tx * TILE, t, (size_t)n * sizeof(float));
+    }
+}
+
+void Heightfield::setRow(int z, const float* in) {
+    if (layout_ == HeightLayout::RowMajor) { std::memcpy(data_.data() + (size_t)z * size_, in, (size_t)size_ * sizeof(float)); return; }
+    float* t = data_.data() + (((size_t)(z >> 3) * tilesX_) << 6) + (size_t)((z & 7) << 3);
+    for (int tx = 0; tx < tilesX_; ++tx, t += TILE * TILE) {
+        int n = std::min(TILE, size_ - tx * TILE);
+        std::memcpy(t, in + tx * TILE, (size_t)n * sizeof(float));
+    }
+}
+
+void Heightfield::assignRowMajor(const float* src) { for (int z = 0; z < size_; ++z) setRow(z, src + (size_t)z * size_); }
+void Heightfield::toRowMajor(float* dst) const { for (int z = 0; z < size_; ++z) copyRow(z, dst + (size_t)z * size_); }
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Memory layout of a Heightfield.
+//  RowMajor: heights[z * N + x]
+//  Tiled:    8x8 blocks (four 64-byte cache lines each) stored contiguously,
+//            blocks in row-major order. Bilinear and 3x3 stencil queries touch
+//            one or two lines instead of one line per grid row, and block
+//            min/max reductions stream contiguous memory.
+enum class HeightLayout { RowMajor = 0, Tiled = 1 };
+
+// Square grid of float heights with point, bilinear, 3x3 stencil and min/max
+// accessors that hide the layout. Grid coordinates are sample indices
+// (0..size-1); callers convert from world space.
+class Heightfield {
+public:
+    static constexpr int TILE = 8; // tile edge in samples
+
+    Heightfield() : size_(0), tilesX_(0), layout_(HeightLayout::Tiled) {}
+    explicit Heightfield(int size, HeightLayout layout = HeightLayout::Tiled) : Heightfield() { resize(size, layout); }
+
+    // Reallocate (contents are zeroed)
+    void resize(int size, HeightLayout layout = HeightLayout::Tiled);
+
+    int size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    HeightLayout layout() const { return layout_; }
+    size_t storageBytes() const { return data_.size() * sizeof(float); }
+
+    // Storage offset of sample (x, z); no bounds checks
+    size_t index(int x, int z) const {
+        if (layout_ == HeightLayout::RowMajor) return (size_t)z * size_ + x;
+        return (((size_t)(z >> 3) * tilesX_ + (size_t)(x >> 3)) << 6) | (size_t)((z & 7) << 3) | (size_t)(x & 7);
+    }
+
+    // Storage distance to the next/previous sample in x or z from (x, z)
+    // (crosses into the neighbouring tile on tile borders; branch-free)
+    ptrdiff_t stepX(int x, int dir) const {
+        if (layout_ == HeightLayout::RowMajor) return dir;
+        ptrdiff_t edge = dir > 0 ? (x & 7) == 7 : (x & 7) == 0;
+        return dir * (1 + edge * 56);
+    }
+    ptrdiff_t stepZ(int z, int dir) const {
+        if (layout_ == HeightLayout::RowMajor) return dir * (ptrdiff_t)size_;
+        ptrdiff_t edge = dir > 0 ? (z & 7) == 7 : (z & 7) == 0;
+        return dir * (8 + edge * ((ptrdiff_t)tilesX_ * 64 - 64));
+    }
+
+    // Point access
+    float at(int x, int z) const { return data_[index(x, z)]; }
+    float& at(int x, int z) { return data_[index(x, z)]; }
+    float atClamped(int x, int z) const;
+
+    // Bilinear interpolation at fractional grid coords (clamped to the grid)
+    float bilinear(float gx, float gz) const;
+
+    // 3x3 neighbourhood around (x, z), edges clamped; out[(dz + 1) * 3 + (dx + 1)]
+    void stencil3x3(int x, int z, float out[9]) const;
+
+    // Min and max over the inclusive block [x0, x1] x [z0, z1] (clamped to the grid)
+    void minMax(int x0, int z0, int x1, int z1, float &mn, float &mx) const;
+
+    // Row transfer (row-major scanlines); used by mesh building and GPU upload
+    void copyRow(int z, float* out) const;
+    void setRow(int z, const float* in);
+    void assignRowMajor(const float* src);
+    void toRowMajor(float* dst) const;
+
+    // Raw storage, addressed through index()/stepX()/stepZ()
+    const float* data() const { return data_.data(); }
+
+    // Direct pointer to row z when the layout is RowMajor, else nullptr
+    const float* rowPointer(int z) const { return layout_ == HeightLayout::RowMajor ? data_.data() + (size_t)z * size_ : nullptr; }
+
+private:
+    int size_;
+    int tilesX_;          // tiles per side (size rounded up to TILE)
+    HeightLayout layout_;
+    std::vector<float> data_;
+};
@@ -0,0 +1,25 @@
+#include "noise.h"
+
+#include <cmath>
+
+// ---------------- Terrain generation inline helpers ----------------
+inline float lerp(float a, float b, float t) { return a + (b - a) * t; } // linear interpolation
+inline float fade(float t) { return t * t * (3.0f - 2.0f * t); }         // fade function for smoothstep
+
+int hashI(int x, int y) { int n = x + y * 57; n = (n << 13) ^ n; return (n * (n * n * 60493 + 19990303) + 1376312589) & 0x7fffffff; } // integer hash
+
+float valueNoise(int x, int y) { return (hashI(x, y) / float(0x7fffffff)) * 2.0f - 1.0f; } // value noise in [-1,1]
+
+// 2D smooth noise
+float smoothNoise(float x, float y) {
+    int xf = (int)floor(x); int yf = (int)floor(y);
+    float xf_frac = x - xf; float yf_frac = y - yf;
+    float v00 = valueNoise(xf, yf); float v10 = valueNoise(xf + 1, yf); float v01 = valueNoise(xf, yf + 1); float v11 = valueNoise(xf + 1, yf + 1);
+    float i1 = lerp(v00, v10, fade(xf_frac)); float i2 = lerp(v01, v11, fade(xf_frac)); return lerp(i1, i2, fade(yf_frac));
+}
+
+float fbmNoise(float x, float y) {
+    float total = 0.0f; float amp = 1.0f; float freq = 1.0f; const int OCT = 6; const float gain = 0.5f;
+    for (int i = 0; i < OCT; ++i) { total += amp * smoothNoise(x * freq, y * freq); freq *= 2.0f; amp *= gain; }
+    return total;
+}
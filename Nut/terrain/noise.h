@@ -0,0 +1,14 @@
+#pragma once
+
+// Value noise used for the procedural terrain. Kept free of GL/engine state
+// so tools (benchmarks, background generation) can evaluate the same field.
+
+// Integer lattice hash and the value noise built on it ([-1, 1])
+int hashI(int x, int y);
+float valueNoise(int x, int y);
+
+// 2D smooth (fade-interpolated) value noise
+float smoothNoise(float x, float y);
+
+// 6-octave fractal sum of smoothNoise (the terrain height field before scaling)
+float fbmNoise(float x, float y);
@@ -0,0 +1,85 @@
+#include "normals.h"
+#include "../core/job_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void computeNormalsAccumulate(const glm::vec3* positions, size_t vertexCount,
+                              const unsigned int* indices, size_t indexCount, glm::vec3* out) {
+    // Compute normals (average face normals)
+    std::fill(out, out + vertexCount, glm::vec3(0.0f));
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        unsigned int i0 = indices[i]; unsigned int i1 = indices[i + 1]; unsigned int i2 = indices[i + 2];
+        glm::vec3 p0 = positions[i0]; glm::vec3 p1 = positions[i1]; glm::vec3 p2 = positions[i2];
+        glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+        out[i0] += normal; out[i1] += normal; out[i2] += normal;
+    }
+
+    // Normalize summed normals
+    for (size_t i = 0; i < vertexCount; ++i) out[i] = glm::normalize(out[i]);
+}
+
+// Normal for one sample from its left/right/back/front neighbours.
+// n = (-dh/dx, 1, -dh/dz) scaled by dx*dz to avoid two divisions.
+static inline glm::vec3 stencilNormal(float hl, float hr, float hb, float hf, float dx, float dz) {
+    glm::vec3 n((hl - hr) * dz, dx * dz, (hb - hf) * dx);
+    return n * (1.0f / std::sqrt(glm::dot(n, n)));
+}
+
+// One output row from its three source scanlines. Interior columns share
+// dx = 2 * spacing which lets the SIMD path process four samples at a time
+// without per-lane branching.
+static void stencilRow(const float* back, const float* row, const float* fwd, int N, float spacing, float dz, glm::vec3* o) {
+    // Borders (one-sided in x)
+    o[0] = stencilNormal(row[0], row[1], back[0], fwd[0], spacing, dz);
+    o[N - 1] = stencilNormal(row[N - 2], row[N - 1], back[N - 1], fwd[N - 1], spacing, dz);
+
+    int x = 1;
+    const float dx = 2.0f * spacing;
+#if defined(__SSE2__)
+    const __m128 vdx = _mm_set1_ps(dx), vdz = _mm_set1_ps(dz), vy = _mm_set1_ps(dx * dz), one = _mm_set1_ps(1.0f);
+    alignas(16) float nx[4], ny[4], nz[4];
+    for (; x + 4 <= N - 1; x += 4) {
+        __m128 hl = _mm_loadu_ps(row + x - 1), hr = _mm_loadu_ps(row + x + 1);
+        __m128 hb = _mm_loadu_ps(back + x),    hf = _mm_loadu_ps(fwd + x);
+        __m128 vx = _mm_mul_ps(_mm_sub_ps(hl, hr), vdz);
+        __m128 vz = _mm_mul_ps(_mm_sub_ps(hb, hf), vdx);
+        __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+        __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(len2));
+        _mm_store_ps(nx, _mm_mul_ps(vx, inv)); _mm_store_ps(ny, _mm_mul_ps(vy, inv)); _mm_store_ps(nz, _mm_mul_ps(vz, inv));
+        for (int k = 0; k < 4; ++k) o[x + k] = glm::vec3(nx[k], ny[k], nz[k]);
+    }
+#endif
+    // Scalar tail (or the whole interior without SSE2)
+    for (; x < N - 1; ++x) o[x] = stencilNormal(row[x - 1], row[x + 1], back[x], fwd[x], dx, dz);
+}
+
+void computeNormalsStencil(const Heightfield &heights, float spacing, glm::vec3* out) {
+    const int N = heights.size();
+    if (N < 2) { if (N == 1) out[0] = glm::vec3(0.0f, 1.0f, 0.0f); return; }
+    JobPool::instance().parallelFor(0, (size_t)N, 16, [&](size_t z0, size_t z1) {
+        // Row-major grids are read in place; tiled ones through a rolling set of scanlines
+        std::vector<float> lines;
+        if (!heights.rowPointer(0)) lines.resize((size_t)N * 3);
+        auto line = [&](int z) -> const float* {
+            if (const float* p = heights.rowPointer(z)) return p;
+            float* l = lines.data() + (size_t)(z % 3) * N;
+            heights.copyRow(z, l);
+            return l;
+        };
+        int first = (int)z0;
+        const float* back = line(std::max(first - 1, 0));
+        const float* row = first > 0 ? line(first) : back;
+        for (int z = first; z < (int)z1; ++z) {
+            const float* fwd = line(std::min(z + 1, N - 1));
+            float dz = (float)(std::min(z + 1, N - 1) - std::max(z - 1, 0)) * spacing;
+            stencilRow(back, row, fwd, N, spacing, dz, out + (size_t)z * N);
+            back = row; row = fwd;
+        }
+    });
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+
+#include "heightfield.h"
+
+// How buildTerrainMesh derives vertex normals.
+//  Accumulate: sum of face normals over the index list (original method)
+//  Stencil:    4-neighbour central difference on the height grid; a pure
+//              streaming pass that is vectorized and split across JobPool
+enum class NormalMode { Accumulate = 0, Stencil = 1 };
+
+// Average the (normalized) face normals of every triangle touching a vertex.
+void computeNormalsAccumulate(const glm::vec3* positions, size_t vertexCount,
+                              const unsigned int* indices, size_t indexCount, glm::vec3* out);
+
+// Central-difference normals for a height grid with the given world spacing
+// between samples, written row-major to out (size^2). Borders fall back to
+// one-sided differences, matching the accumulated result on flat edges.
+// Tiled grids are streamed through per-thread scanline buffers.
+void computeNormalsStencil(const Heightfield &heights, float spacing, glm::vec3* out);
@@ -0,0 +1,77 @@
+#include "agents.h"
+#include "../terrain/height_query.h"
+#include "../core/job_pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+void Agents::reserve(size_t n) {
+    px_.reserve(n); py_.reserve(n); pz_.reserve(n); dirX_.reserve(n); dirZ_.reserve(n);
+    speed_.reserve(n); velY_.reserve(n); airborne_.reserve(n);
+}
+
+void Agents::clear() {
+    px_.clear(); py_.clear(); pz_.clear(); dirX_.clear(); dirZ_.clear();
+    speed_.clear(); velY_.clear(); airborne_.clear();
+}
+
+size_t Agents::spawn(const glm::vec3 &pos, float heading, float speed) {
+    px_.push_back(pos.x); py_.push_back(pos.y); pz_.push_back(pos.z);
+    dirX_.push_back(std::cos(heading)); dirZ_.push_back(std::sin(heading));
+    speed_.push_back(speed); velY_.push_back(0.0f); airborne_.push_back(0);
+    return size() - 1;
+}
+
+void Agents::remove(size_t i) {
+    size_t last = size() - 1;
+    px_[i] = px_[last]; py_[i] = py_[last]; pz_[i] = pz_[last]; dirX_[i] = dirX_[last]; dirZ_[i] = dirZ_[last];
+    speed_[i] = speed_[last]; velY_[i] = velY_[last]; airborne_[i] = airborne_[last];
+    px_.pop_back(); py_.pop_back(); pz_.pop_back(); dirX_.pop_back(); dirZ_.pop_back();
+    speed_.pop_back(); velY_.pop_back(); airborne_.pop_back();
+}
+
+void Agents::jump(size_t i, float velocity) {
+    if (airborne_[i]) return;
+    airborne_[i] = 1; velY_[i] = velocity;
+}
+
+void Agents::update(const TerrainGrid &grid, float dt, const AgentParams &params) {
+    const float minX = grid.originX, minZ = grid.originZ;
+    const float maxX = minX + (grid.heights.size() - 1) * grid.spacing, maxZ = minZ + (grid.heights.size() - 1) * grid.spacing;
+    float *px = px_.data(), *py = py_.data(), *pz = pz_.data(), *dx = dirX_.data(), *dz = dirZ_.data();
+    const float *sp = speed_.data(); float *vy = velY_.data(); uint8_t *air = airborne_.data();
+
+    // Blocks of BLOCK agents run all three systems back to back while their
+    // components are still in cache; the pool hands out runs of blocks
+    const size_t BLOCK = 2048;
+    JobPool::instance().parallelFor(0, size(), BLOCK, [&](size_t begin, size_t end) {
+        float ground[BLOCK];
+        for (size_t b = begin; b < end; b += BLOCK) {
+            size_t e = std::min(end, b + BLOCK);
+
+            // Movement: straight ahead, reflecting off the grid edges
+            for (size_t i = b; i < e; ++i) {
+                float x = px[i] + dx[i] * sp[i] * dt, z = pz[i] + dz[i] * sp[i] * dt;
+                float rx = (x < minX || x > maxX) ? -1.0f : 1.0f, rz = (z < minZ || z > maxZ) ? -1.0f : 1.0f;
+                dx[i] *= rx; dz[i] *= rz;
+                px[i] = std::min(std::max(x, minX), maxX); pz[i] = std::min(std::max(z, minZ), maxZ);
+            }
+
+            // Gravity (airborne agents only; branch-free so it vectorizes)
+            for (size_t i = b; i < e; ++i) {
+                float a = (float)air[i];
+                py[i] += a * vy[i] * dt; vy[i] -= a * params.gravity * dt;
+            }
+
+            // Terrain snap: grounded agents follow the surface, airborne ones land on it
+            grid.queryBatch(px + b, pz + b, e - b, ground);
+            for (size_t i = b; i < e; ++i) {
+                float gy = ground[i - b] + params.heightOffset;
+                bool land = !air[i] || py[i] <= gy;
+                py[i] = land ? gy : py[i];
+                vy[i] = land ? 0.0f : vy[i];
+                air[i] = land ? 0 : air[i];
+            }
+        }
+    });
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct TerrainGrid;
+
+// Physics shared by every agent; defaults mirror Engine::updateMovement
+struct AgentParams {
+    float gravity = 18.0f;
+    float jumpVelocity = 7.0f;
+    float heightOffset = 1.7f;   // body height above the ground (the camera's eye height)
+};
+
+// Structure-of-arrays store for many terrain-walking agents. Agent i lives
+// at index i of every component array; remove() swaps the last agent into
+// the hole, so indices are stable only until the next removal.
+class Agents {
+public:
+    size_t size() const { return px_.size(); }
+    void reserve(size_t n);
+    void clear();
+
+    size_t spawn(const glm::vec3 &pos, float heading, float speed);
+    void remove(size_t i);
+    void jump(size_t i, float velocity);      // ignored while airborne
+
+    // One tick of the movement, gravity and terrain-snap systems, run in
+    // chunks across JobPool. Agents reflect off the edges of the grid.
+    void update(const TerrainGrid &grid, float dt, const AgentParams &params = AgentParams());
+
+    // Component access
+    glm::vec3 position(size_t i) const { return glm::vec3(px_[i], py_[i], pz_[i]); }
+    bool airborne(size_t i) const { return airborne_[i] != 0; }
+    const float* posX() const { return px_.data(); }
+    const float* posY() const { return py_.data(); }
+    const float* posZ() const { return pz_.data(); }
+
+private:
+    std::vector<float> px_, py_, pz_;   // position
+    std::vector<float> dirX_, dirZ_;    // unit heading on the ground plane
+    std::vector<float> speed_;          // ground speed, units/s
+    std::vector<float> velY_;           // vertical velocity while airborne
+    std::vector<uint8_t> airborne_;
+};
@@ -0,0 +1,442 @@
+#include "pathfinder.h"
+#include "../core/job_pool.h"
+#include "../terrain/height_query.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+const float INF = std::numeric_limits<float>::infinity();
+const float SQRT2 = 1.41421356f;
+const int DX[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+const int DZ[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+// Samples [x0, x1) x [z0, z1) a search may visit
+struct Rect { int x0, z0, x1, z1; };
+
+// Step costs over one grid (see NavParams)
+struct Costs {
+    const Heightfield* h;
+    int n;
+    float spacing, maxSlope, penalty;
+
+    Costs(const TerrainGrid &grid, const NavParams &p)
+        : h(&grid.heights), n(grid.heights.size()), spacing(grid.spacing), maxSlope(p.maxSlope), penalty(p.slopePenalty) {}
+
+    // Cost of stepping (x, z) -> (x + dx, z + dz); negative when too steep
+    float step(int x, int z, int dx, int dz) const {
+        float d = (dx && dz) ? spacing * SQRT2 : spacing;
+        float s = std::fabs(h->at(x + dx, z + dz) - h->at(x, z)) / d;
+        return s > maxSlope ? -1.0f : d * (1.0f + penalty * s);
+    }
+    // Octile distance: a lower bound since every step costs at least its length
+    float estimate(int a, int b) const {
+        int dx = std::abs(a % n - b % n), dz = std::abs(a / n - b / n);
+        return spacing * ((float)std::max(dx, dz) + (SQRT2 - 1.0f) * (float)std::min(dx, dz));
+    }
+};
+
+// Per-thread scratch for the bounded grid searches; generation stamps avoid
+// clearing between searches
+struct GridScratch {
+    std::vector<float> g, h;
+    std::vector<int> parent, target;
+    std::vector<uint32_t> seen, closed, marked;
+    std::vector<std::pair<float, int>> heap;
+    uint32_t gen = 0;
+
+    void begin(size_t cells) {
+        if (g.size() < cells) {
+            g.resize(cells); h.resize(cells); parent.resize(cells); target.resize(cells);
+            seen.assign(cells, 0); closed.assign(cells, 0); marked.assign(cells, 0); gen = 0;
+        }
+        if (++gen == 0) {
+            std::fill(seen.begin(), seen.end(), 0); std::fill(closed.begin(), closed.end(), 0);
+            std::fill(marked.begin(), marked.end(), 0); gen = 1;
+        }
+        heap.clear();
+    }
+};
+
+struct HeapLess { bool operator()(const std::pair<float, int> &a, const std::pair<float, int> &b) const { return a.first > b.first; } };
+
+// Search inside r from sample src. With goal >= 0 this is A* and returns the
+// cost to goal (INF if unreachable), filling path (src..goal) when given.
+// With goal < 0 it is Dijkstra and stops once every target is settled,
+// writing costs[k] for targets[k].
+float searchGrid(const Costs &c, const Rect &r, int src, int goal, const int* targets, int ntargets,
+                 float* costs, std::vector<int>* path) {
+    thread_local GridScratch s;
+    int w = r.x1 - r.x0, rows = r.z1 - r.z0;
+    s.begin((size_t)w * rows);
+    auto local = [&](int cell) { return (cell / c.n - r.z0) * w + (cell % c.n - r.x0); };
+
+    // Row-major copy of the heights in r: the expansion loop then needs no
+    // Heightfield indexing
+    for (int z = 0; z < rows; ++z) for (int x = 0; x < w; ++x) s.h[z * w + x] = c.h->at(r.x0 + x, r.z0 + z);
+    const float inv[2] = {1.0f / c.spacing, 1.0f / (c.spacing * SQRT2)}, len[2] = {c.spacing, c.spacing * SQRT2};
+    int gl = goal >= 0 ? local(goal) : -1, gx = gl % w, gz = gl / w;
+    auto estimate = [&](int l) {
+        int dx = std::abs(l % w - gx), dz = std::abs(l / w - gz);
+        return c.spacing * ((float)std::max(dx, dz) + (SQRT2 - 1.0f) * (float)std::min(dx, dz));
+    };
+
+    int remaining = ntargets;
+    for (int k = 0; k < ntargets; ++k) { costs[k] = INF; s.target[local(targets[k])] = k; s.marked[local(targets[k])] = s.gen; }
+    int sl = local(src);
+    s.g[sl] = 0.0f; s.parent[sl] = -1; s.seen[sl] = s.gen;
+    s.heap.push_back({goal >= 0 ? estimate(sl) : 0.0f, sl});
+    while (!s.heap.empty()) {
+        std::pop_heap(s.heap.begin(), s.heap.end(), HeapLess());
+        int l = s.heap.back().second; s.heap.pop_back();
+        if (s.closed[l] == s.gen) continue;
+        s.closed[l] = s.gen;
+        if (l == gl) {
+            if (path) {
+                size_t first = path->size();
+                for (int k = l; k >= 0; k = s.parent[k]) path->push_back((r.z0 + k / w) * c.n + r.x0 + k % w);
+                std::reverse(path->begin() + first, path->end());
+            }
+            return s.g[l];
+        }
+        if (s.marked[l] == s.gen) {
+            costs[s.target[l]] = s.g[l];
+            if (--remaining == 0) break;
+        }
+        int x = l % w, z = l / w;
+        float hl = s.h[l], gcur = s.g[l];
+        for (int d = 0; d < 8; ++d) {
+            int nx = x + DX[d], nz = z + DZ[d];
+            if ((unsigned)nx >= (unsigned)w || (unsigned)nz >= (unsigned)rows) continue;
+            int nl = nz * w + nx;
+            if (s.closed[nl] == s.gen) continue;
+            int diag = d >= 4;
+            float slope = std::fabs(s.h[nl] - hl) * inv[diag];
+            if (slope > c.maxSlope) continue;
+            float ng = gcur + len[diag] * (1.0f + c.penalty * slope);
+            if (s.seen[nl] == s.gen && ng >= s.g[nl]) continue;
+            s.seen[nl] = s.gen; s.g[nl] = ng; s.parent[nl] = l;
+            s.heap.push_back({goal >= 0 ? ng + estimate(nl) : ng, nl});
+            std::push_heap(s.heap.begin(), s.heap.end(), HeapLess());
+        }
+    }
+    return INF;
+}
+
+} // namespace
+
+struct PathFinder::Graph {
+    std::shared_ptr<const TerrainGrid> grid;
+    NavParams params;
+    int n = 0, size = 32, side = 0;                       // samples per side, cluster size, clusters per side
+    std::vector<std::vector<std::pair<int, int>>> vBorder; // cz * side + cx: transitions cx -> cx + 1
+    std::vector<std::vector<std::pair<int, int>>> hBorder; // cz * side + cx: transitions cz -> cz + 1
+    std::vector<std::vector<int>> nodes;                   // per cluster: entrance samples, sorted
+    std::vector<std::vector<float>> dist;                  // per cluster: nodes^2 intra-cluster costs
+
+    // Flattened abstract graph (CSR), rebuilt after any cluster change
+    std::vector<uint32_t> base;       // first node id of each cluster
+    std::vector<int> nodeSample;
+    std::vector<uint32_t> edgeStart, edgeTo;
+    std::vector<float> edgeCost;
+
+    int clusterOf(int sample) const { return (sample / n / size) * side + (sample % n) / size; }
+    Rect rect(int cluster) const {
+        int cx = cluster % side, cz = cluster / side;
+        return {cx * size, cz * size, std::min((cx + 1) * size, n), std::min((cz + 1) * size, n)};
+    }
+    int node(int cluster, int sample) const {
+        const std::vector<int> &v = nodes[cluster];
+        return (int)base[cluster] + (int)(std::lower_bound(v.begin(), v.end(), sample) - v.begin());
+    }
+
+    void buildBorder(const Costs &c, int cx, int cz, bool vertical);
+    void buildCluster(const Costs &c, int cluster);
+    void flatten(const Costs &c);
+};
+
+// Entrances along one border: every maximal run of passable crossings
+// becomes one transition in its middle, or two at its ends when long
+void PathFinder::Graph::buildBorder(const Costs &c, int cx, int cz, bool vertical) {
+    std::vector<std::pair<int, int>> &out = (vertical ? vBorder : hBorder)[cz * side + cx];
+    out.clear();
+    Rect r = rect(cz * side + cx);
+    if (vertical ? r.x1 >= n : r.z1 >= n) return;
+    int len = vertical ? r.z1 - r.z0 : r.x1 - r.x0;
+    auto crossing = [&](int k) {
+        int x = vertical ? r.x1 - 1 : r.x0 + k, z = vertical ? r.z0 + k : r.z1 - 1;
+        return std::make_pair(z * n + x, vertical ? z * n + x + 1 : (z + 1) * n + x);
+    };
+    auto open = [&](int k) {
+        int x = vertical ? r.x1 - 1 : r.x0 + k, z = vertical ? r.z0 + k : r.z1 - 1;
+        return c.step(x, z, vertical ? 1 : 0, vertical ? 0 : 1) >= 0.0f;
+    };
+    for (int k = 0; k < len;) {
+        if (!open(k)) { ++k; continue; }
+        int e = k;
+        while (e < len && open(e)) ++e;
+        if (e - k >= 6) { out.push_back(crossing(k)); out.push_back(crossing(e - 1)); }
+        else out.push_back(crossing((k + e - 1) / 2));
+        k = e;
+    }
+}
+
+// Entrance samples of a cluster (from its four borders) and the costs between them
+void PathFinder::Graph::buildCluster(const Costs &c, int cluster) {
+    int cx = cluster % side, cz = cluster / side;
+    std::vector<int> &v = nodes[cluster];
+    v.clear();
+    if (cx > 0) for (auto &t : vBorder[cluster - 1]) v.push_back(t.second);
+    if (cz > 0) for (auto &t : hBorder[cluster - side]) v.push_back(t.second);
+    for (auto &t : vBorder[cluster]) v.push_back(t.first);
+    for (auto &t : hBorder[cluster]) v.push_back(t.first);
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+
+    int k = (int)v.size();
+    std::vector<float> &d = dist[cluster];
+    d.assign((size_t)k * k, INF);
+    Rect r = rect(cluster);
+    for (int i = 0; i < k; ++i) {
+        // Costs are symmetric: search only towards the nodes after i
+        if (i + 1 < k) searchGrid(c, r, v[i], -1, v.data() + i + 1, k - i - 1, d.data() + (size_t)i * k + i + 1, nullptr);
+        d[(size_t)i * k + i] = 0.0f;
+        for (int j = i + 1; j < k; ++j) d[(size_t)j * k + i] = d[(size_t)i * k + j];
+    }
+}
+
+void PathFinder::Graph::flatten(const Costs &c) {
+    size_t clusters = nodes.size();
+    base.resize(clusters + 1);
+    base[0] = 0;
+    for (size_t i = 0; i < clusters; ++i) base[i + 1] = base[i] + (uint32_t)nodes[i].size();
+    uint32_t count = base[clusters];
+    nodeSample.resize(count);
+    edgeStart.assign((size_t)count + 1, 0);
+
+    // Inter-cluster edges are single straight steps across a border
+    std::vector<std::pair<uint32_t, uint32_t>> links;
+    for (size_t i = 0; i < clusters; ++i) {
+        for (auto &t : vBorder[i]) links.push_back({(uint32_t)node((int)i, t.first), (uint32_t)node((int)i + 1, t.second)});
+        for (auto &t : hBorder[i]) links.push_back({(uint32_t)node((int)i, t.first), (uint32_t)node((int)i + side, t.second)});
+    }
+    for (size_t i = 0; i < clusters; ++i) {
+        size_t k = nodes[i].size();
+        for (size_t a = 0; a < k; ++a) {
+            nodeSample[base[i] + a] = nodes[i][a];
+            for (size_t b = 0; b < k; ++b) if (a != b && dist[i][a * k + b] < INF) ++edgeStart[base[i] + a + 1];
+        }
+    }
+    for (auto &l : links) { ++edgeStart[l.first + 1]; ++edgeStart[l.second + 1]; }
+    for (uint32_t i = 0; i < count; ++i) edgeStart[i + 1] += edgeStart[i];
+    edgeTo.resize(edgeStart[count]); edgeCost.resize(edgeStart[count]);
+    std::vector<uint32_t> fill(edgeStart.begin(), edgeStart.end() - 1);
+    for (size_t i = 0; i < clusters; ++i) {
+        size_t k = nodes[i].size();
+        for (size_t a = 0; a < k; ++a) for (size_t b = 0; b < k; ++b) {
+            float d = dist[i][a * k + b];
+            if (a == b || d == INF) continue;
+            uint32_t slot = fill[base[i] + a]++;
+            edgeTo[slot] = base[i] + (uint32_t)b; edgeCost[slot] = d;
+        }
+    }
+    for (auto &l : links) {
+        int s = nodeSample[l.first], t = nodeSample[l.second];
+        float cost = c.step(s % n, s / n, t % n - s % n, t / n - s / n);
+        uint32_t slot = fill[l.first]++;
+        edgeTo[slot] = l.second; edgeCost[slot] = cost;
+        slot = fill[l.second]++;
+        edgeTo[slot] = l.first; edgeCost[slot] = cost;
+    }
+}
+
+PathFinder::PathFinder() {}
+PathFinder::~PathFinder() {}
+
+void PathFinder::build(std::shared_ptr<const TerrainGrid> grid, const NavParams &params) {
+    if (!grid || grid->heights.size() < 2) { std::atomic_store(&graph_, std::shared_ptr<const Graph>()); return; }
+    auto g = std::make_shared<Graph>();
+    g->grid = grid; g->params = params;
+    g->n = grid->heights.size();
+    g->size = std::max(params.clusterSize, 4);
+    g->side = (g->n + g->size - 1) / g->size;
+    size_t clusters = (size_t)g->side * g->side;
+    g->vBorder.resize(clusters); g->hBorder.resize(clusters);
+    g->nodes.resize(clusters); g->dist.resize(clusters);
+
+    Costs c(*grid, params);
+    JobPool &pool = JobPool::instance();
+    pool.parallelFor(0, clusters, 16, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) {
+            g->buildBorder(c, (int)i % g->side, (int)i / g->side, true);
+            g->buildBorder(c, (int)i % g->side, (int)i / g->side, false);
+        }
+    });
+    pool.parallelFor(0, clusters, 1, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) g->buildCluster(c, (int)i);
+    });
+    g->flatten(c);
+    std::atomic_store(&graph_, std::shared_ptr<const Graph>(std::move(g)));
+}
+
+void PathFinder::updateRegion(std::shared_ptr<const TerrainGrid> grid, int x0, int z0, int x1, int z1) {
+    std::shared_ptr<const Graph> old = std::atomic_load(&graph_);
+    if (!old || !grid || grid->heights.size() != old->n || grid->originX != old->grid->originX ||
+        grid->originZ != old->grid->originZ || grid->spacing != old->grid->spacing) {
+        build(grid, old ? old->params : NavParams());
+        return;
+    }
+    auto g = std::make_shared<Graph>(*old);
+    g->grid = grid;
+    int n = g->n, size = g->size, side = g->side;
+
+    // A changed sample alters the steps into it from its neighbours too
+    x0 = std::max(x0 - 1, 0); z0 = std::max(z0 - 1, 0);
+    x1 = std::min(x1 + 1, n - 1); z1 = std::min(z1 + 1, n - 1);
+    if (x0 > x1 || z0 > z1) return;
+    int cx0 = x0 / size, cz0 = z0 / size, cx1 = x1 / size, cz1 = z1 / size;
+
+    // Borders of the dirty clusters, then every cluster that owns one of them
+    Costs c(*grid, g->params);
+    for (int cz = std::max(cz0 - 1, 0); cz <= cz1; ++cz)
+        for (int cx = cx0; cx <= cx1; ++cx) g->buildBorder(c, cx, cz, false);
+    for (int cz = cz0; cz <= cz1; ++cz)
+        for (int cx = std::max(cx0 - 1, 0); cx <= cx1; ++cx) g->buildBorder(c, cx, cz, true);
+    std::vector<int> dirty;
+    for (int cz = std::max(cz0 - 1, 0); cz <= std::min(cz1 + 1, side - 1); ++cz)
+        for (int cx = std::max(cx0 - 1, 0); cx <= std::min(cx1 + 1, side - 1); ++cx) {
+            bool inX = cx >= cx0 && cx <= cx1, inZ = cz >= cz0 && cz <= cz1;
+            if (inX || inZ) dirty.push_back(cz * side + cx); // skip diagonal neighbours: no shared border
+        }
+    JobPool::instance().parallelFor(0, dirty.size(), 1, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) g->buildCluster(c, dirty[i]);
+    });
+    g->flatten(c);
+    std::atomic_store(&graph_, std::shared_ptr<const Graph>(std::move(g)));
+}
+
+bool PathFinder::ready() const { return (bool)std::atomic_load(&graph_); }
+
+size_t PathFinder::abstractNodes() const {
+    std::shared_ptr<const Graph> g = std::atomic_load(&graph_);
+    return g ? g->nodeSample.size() : 0;
+}
+
+namespace {
+
+// Per-thread scratch for the abstract search
+struct NodeScratch {
+    std::vector<float> g;
+    std::vector<int> parent;
+    std::vector<uint32_t> seen, closed;
+    std::vector<std::pair<float, int>> heap;
+    uint32_t gen = 0;
+
+    void begin(size_t count) {
+        if (g.size() < count) { g.resize(count); parent.resize(count); seen.assign(count, 0); closed.assign(count, 0); gen = 0; }
+        if (++gen == 0) { std::fill(seen.begin(), seen.end(), 0); std::fill(closed.begin(), closed.end(), 0); gen = 1; }
+        heap.clear();
+    }
+};
+
+bool findPathIn(const PathFinder::Graph &g, const glm::vec3 &from, const glm::vec3 &to, std::vector<glm::vec3> &out);
+
+} // namespace
+
+bool PathFinder::findPath(const glm::vec3 &from, const glm::vec3 &to, std::vector<glm::vec3> &out) const {
+    out.clear();
+    std::shared_ptr<const Graph> g = std::atomic_load(&graph_);
+    return g && findPathIn(*g, from, to, out);
+}
+
+void PathFinder::findPaths(const Request* requests, size_t count, std::vector<std::vector<glm::vec3>> &out) const {
+    out.resize(count);
+    std::shared_ptr<const Graph> g = std::atomic_load(&graph_);
+    JobPool::instance().parallelFor(0, count, 4, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) {
+            out[i].clear();
+            if (g) findPathIn(*g, requests[i].from, requests[i].to, out[i]);
+        }
+    });
+}
+
+namespace {
+
+bool findPathIn(const PathFinder::Graph &g, const glm::vec3 &from, const glm::vec3 &to, std::vector<glm::vec3> &out) {
+    const TerrainGrid &grid = *g.grid;
+    Costs c(grid, g.params);
+    int n = g.n;
+    auto sample = [&](const glm::vec3 &p) {
+        int x = std::clamp((int)std::lround((p.x - grid.originX) / grid.spacing), 0, n - 1);
+        int z = std::clamp((int)std::lround((p.z - grid.originZ) / grid.spacing), 0, n - 1);
+        return z * n + x;
+    };
+    int src = sample(from), dst = sample(to);
+    int cs = g.clusterOf(src), cg = g.clusterOf(dst);
+
+    std::vector<int> cells;
+    auto emit = [&]() {
+        for (int s : cells) {
+            int x = s % n, z = s / n;
+            out.push_back({grid.originX + x * grid.spacing, grid.heights.at(x, z), grid.originZ + z * grid.spacing});
+        }
+        return true;
+    };
+    // Same cluster: a bounded search usually settles it without the graph
+    if (cs == cg && searchGrid(c, g.rect(cs), src, dst, nullptr, 0, nullptr, &cells) < INF) return emit();
+    cells.clear();
+
+    // Connect start and goal to the entrances of their clusters
+    const std::vector<int> &sn = g.nodes[cs], &gn = g.nodes[cg];
+    std::vector<float> sCost(sn.size()), gCost(gn.size());
+    if (sn.empty() || gn.empty()) return false;
+    searchGrid(c, g.rect(cs), src, -1, sn.data(), (int)sn.size(), sCost.data(), nullptr);
+    searchGrid(c, g.rect(cg), dst, -1, gn.data(), (int)gn.size(), gCost.data(), nullptr);
+
+    // A* over the abstract graph; id `goal` stands for dst
+    thread_local NodeScratch s;
+    int goal = (int)g.nodeSample.size();
+    s.begin((size_t)goal + 1);
+    auto relax = [&](int v, float ng, int from) {
+        if (s.closed[v] == s.gen || (s.seen[v] == s.gen && ng >= s.g[v])) return;
+        s.seen[v] = s.gen; s.g[v] = ng; s.parent[v] = from;
+        s.heap.push_back({ng + (v == goal ? 0.0f : c.estimate(g.nodeSample[v], dst)), v});
+        std::push_heap(s.heap.begin(), s.heap.end(), HeapLess());
+    };
+    for (size_t k = 0; k < sn.size(); ++k) if (sCost[k] < INF) relax((int)g.base[cs] + (int)k, sCost[k], -1);
+    bool found = false;
+    while (!s.heap.empty()) {
+        std::pop_heap(s.heap.begin(), s.heap.end(), HeapLess());
+        int u = s.heap.back().second; s.heap.pop_back();
+        if (s.closed[u] == s.gen) continue;
+        s.closed[u] = s.gen;
+        if (u == goal) { found = true; break; }
+        for (uint32_t e = g.edgeStart[u]; e < g.edgeStart[u + 1]; ++e) relax((int)g.edgeTo[e], s.g[u] + g.edgeCost[e], u);
+        if ((uint32_t)u >= g.base[cg] && (uint32_t)u < g.base[cg + 1] && gCost[u - g.base[cg]] < INF)
+            relax(goal, s.g[u] + gCost[u - g.base[cg]], u);
+    }
+    if (!found) return false;
+
+    // Refine: hops inside a cluster become bounded searches, border hops single steps
+    std::vector<int> hops;
+    for (int v = s.parent[goal]; v >= 0; v = s.parent[v]) hops.push_back(g.nodeSample[v]);
+    hops.push_back(src);
+    std::reverse(hops.begin(), hops.end());
+    hops.push_back(dst);
+    cells.push_back(src);
+    for (size_t i = 1; i < hops.size(); ++i) {
+        int a = hops[i - 1], b = hops[i];
+        if (a == b) continue;
+        int ca = g.clusterOf(a);
+        if (ca != g.clusterOf(b)) { cells.push_back(b); continue; }
+        size_t first = cells.size();
+        if (searchGrid(c, g.rect(ca), a, b, nullptr, 0, nullptr, &cells) == INF) return false;
+        cells.erase(cells.begin() + first); // a is already there
+    }
+    return emit();
+}
+
+} // namespace
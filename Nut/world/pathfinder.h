@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+struct TerrainGrid;
+
+// Movement rules over the terrain grid. Agents step between neighbouring
+// samples (8-connected); a step of horizontal length d rising or falling dh
+// costs d * (1 + slopePenalty * |dh| / d) and is blocked when |dh| / d
+// exceeds maxSlope.
+struct NavParams {
+    int clusterSize = 32;        // samples per cluster side
+    float maxSlope = 1.0f;       // 45 degrees
+    float slopePenalty = 4.0f;
+};
+
+// Hierarchical pathfinding (HPA*) over a TerrainGrid. The grid is cut into
+// clusterSize^2 clusters; passable runs along each cluster border become
+// entrances, and costs between the entrances of a cluster are precomputed.
+// A query searches that small abstract graph and then refines each hop with
+// a search bounded to one cluster.
+//
+// The abstract graph is immutable once published: queries take a snapshot
+// and may run concurrently from any thread, while build() / updateRegion()
+// prepare a new graph and swap it in (same scheme as HeightQuery).
+class PathFinder {
+public:
+    struct Graph;
+    struct Request { glm::vec3 from, to; };
+
+    PathFinder();
+    ~PathFinder();
+
+    // Full build over grid (clusters in parallel on JobPool)
+    void build(std::shared_ptr<const TerrainGrid> grid, const NavParams &params = NavParams());
+
+    // grid differs from the current one only inside samples [x0, x1] x [z0, z1]
+    // (same size and placement): rebuild just the clusters that touch it and
+    // their neighbours. Falls back to build() when the layout changed.
+    void updateRegion(std::shared_ptr<const TerrainGrid> grid, int x0, int z0, int x1, int z1);
+
+    bool ready() const;
+    size_t abstractNodes() const;
+
+    // Path between two world positions as sample-centred waypoints (empty
+    // and false when unreachable). Thread-safe.
+    bool findPath(const glm::vec3 &from, const glm::vec3 &to, std::vector<glm::vec3> &out) const;
+
+    // Many requests spread across JobPool, all against one snapshot
+    void findPaths(const Request* requests, size_t count, std::vector<std::vector<glm::vec3>> &out) const;
+
+private:
+    std::shared_ptr<const Graph> graph_;
+};
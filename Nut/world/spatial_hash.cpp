@@ -0,0 +1,108 @@
+#include "spatial_hash.h"
+#include "../core/job_pool.h"
+
+#include <algorithm>
+#include <cmath>
+
+SpatialHash::SpatialHash(float cellSize, float originX, float originZ) : side_(1), shift_(0) {
+    setCell(cellSize, originX, originZ);
+}
+
+void SpatialHash::setCell(float cellSize, float originX, float originZ) {
+    cell_ = std::max(cellSize, 1e-3f); invCell_ = 1.0f / cell_;
+    originX_ = originX; originZ_ = originZ;
+}
+
+int SpatialHash::cellX(float x) const { return (int)std::floor((x - originX_) * invCell_); }
+int SpatialHash::cellZ(float z) const { return (int)std::floor((z - originZ_) * invCell_); }
+
+uint32_t SpatialHash::bucket(int cx, int cz) const {
+    return ((uint32_t)cz & (side_ - 1)) << shift_ | ((uint32_t)cx & (side_ - 1));
+}
+
+void SpatialHash::build(const float* xs, const float* zs, size_t count) {
+    // Wrapped side x side grid with at least two buckets per object
+    shift_ = 3;
+    while (((size_t)1 << (2 * shift_)) < count * 2 && shift_ < 15) ++shift_;
+    side_ = 1u << shift_;
+    uint32_t buckets = side_ * side_;
+
+    keys_.resize(count);
+    JobPool::instance().parallelFor(0, count, 16384, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) keys_[i] = bucket(cellX(xs[i]), cellZ(zs[i]));
+    });
+
+    // Counting sort by bucket
+    start_.assign((size_t)buckets + 1, 0);
+    for (size_t i = 0; i < count; ++i) ++start_[keys_[i] + 1];
+    for (size_t b = 0; b < buckets; ++b) start_[b + 1] += start_[b];
+    ids_.resize(count); xs_.resize(count); zs_.resize(count);
+    std::vector<uint32_t> fill(start_.begin(), start_.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t slot = fill[keys_[i]]++;
+        ids_[slot] = (uint32_t)i; xs_[slot] = xs[i]; zs_[slot] = zs[i];
+    }
+}
+
+template <typename Fn>
+void SpatialHash::forBuckets(int cx0, int cz0, int cx1, int cz1, Fn fn) const {
+    // Cells share a bucket only a full wrap (side_ cells) apart, so with each
+    // axis clamped to side_ cells every cell left maps to its own bucket
+    int64_t nx = std::min<int64_t>((int64_t)cx1 - cx0 + 1, side_);
+    int64_t nz = std::min<int64_t>((int64_t)cz1 - cz0 + 1, side_);
+    if (nx == side_ && nz == side_) { fn(0u, (uint32_t)ids_.size()); return; } // every bucket: one scan
+    for (int64_t z = 0; z < nz; ++z) for (int64_t x = 0; x < nx; ++x) {
+        uint32_t b = bucket((int)(cx0 + x), (int)(cz0 + z));
+        fn(start_[b], start_[b + 1]);
+    }
+}
+
+void SpatialHash::queryRadius(float x, float z, float radius, std::vector<uint32_t> &out) const {
+    if (ids_.empty()) return;
+    float r2 = radius * radius;
+    forBuckets(cellX(x - radius), cellZ(z - radius), cellX(x + radius), cellZ(z + radius), [&](uint32_t b, uint32_t e) {
+        for (uint32_t k = b; k < e; ++k) {
+            float dx = xs_[k] - x, dz = zs_[k] - z;
+            if (dx * dx + dz * dz <= r2) out.push_back(ids_[k]);
+        }
+    });
+}
+
+void SpatialHash::queryBox(float minX, float minZ, float maxX, float maxZ, std::vector<uint32_t> &out) const {
+    if (ids_.empty()) return;
+    forBuckets(cellX(minX), cellZ(minZ), cellX(maxX), cellZ(maxZ), [&](uint32_t b, uint32_t e) {
+        for (uint32_t k = b; k < e; ++k)
+            if (xs_[k] >= minX && xs_[k] <= maxX && zs_[k] >= minZ && zs_[k] <= maxZ) out.push_back(ids_[k]);
+    });
+}
+
+void SpatialHash::findPairs(float radius, std::vector<std::pair<uint32_t, uint32_t>> &out) const {
+    out.clear();
+    size_t n = ids_.size();
+    if (!n) return;
+    float r2 = radius * radius;
+
+    // Walk the sorted entries so neighbouring work touches the same buckets;
+    // each chunk collects its own pairs and they are concatenated afterwards
+    const size_t grain = 4096;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> parts((n + grain - 1) / grain);
+    JobPool::instance().parallelFor(0, parts.size(), 1, [&](size_t pb, size_t pe) {
+        for (size_t p = pb; p < pe; ++p) {
+            std::vector<std::pair<uint32_t, uint32_t>> &local = parts[p];
+            for (size_t k = p * grain, ke = std::min(n, k + grain); k < ke; ++k) {
+                float x = xs_[k], z = zs_[k]; uint32_t id = ids_[k];
+                forBuckets(cellX(x - radius), cellZ(z - radius), cellX(x + radius), cellZ(z + radius), [&](uint32_t b, uint32_t e) {
+                    for (uint32_t j = b; j < e; ++j) {
+                        if (ids_[j] <= id) continue; // each pair once, from its lower id
+                        float dx = xs_[j] - x, dz = zs_[j] - z;
+                        if (dx * dx + dz * dz <= r2) local.push_back(std::make_pair(id, ids_[j]));
+                    }
+                });
+            }
+        }
+    });
+    size_t total = 0;
+    for (const auto &p : parts) total += p.size();
+    out.reserve(total);
+    for (const auto &p : parts) out.insert(out.end(), p.begin(), p.end());
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Uniform spatial hash over the XZ plane for proximity queries between many
+// moving objects. Cells are cellSize wide and anchored at (originX, originZ)
+// (use the terrain grid origin and a divisor of the patch size so cells line
+// up with terrain chunks). The hash wraps cell coordinates onto a
+// power-of-two grid of buckets, so neighbouring cells are neighbouring
+// buckets; cells a full wrap apart share one and are told apart by the exact
+// position tests. build() re-sorts every object into its bucket with a
+// counting sort each tick: ids and positions end up contiguous per bucket,
+// so queries stream through memory instead of chasing pointers.
+class SpatialHash {
+public:
+    explicit SpatialHash(float cellSize = 4.0f, float originX = 0.0f, float originZ = 0.0f);
+
+    void setCell(float cellSize, float originX, float originZ);
+    float cellSize() const { return cell_; }
+
+    // Rebuild from count positions; object i keeps id i
+    void build(const float* xs, const float* zs, size_t count);
+    size_t size() const { return ids_.size(); }
+
+    // Ids of objects within radius of (x, z) / inside [minX, maxX] x [minZ, maxZ]
+    // (exact tests, appended to out)
+    void queryRadius(float x, float z, float radius, std::vector<uint32_t> &out) const;
+    void queryBox(float minX, float minZ, float maxX, float maxZ, std::vector<uint32_t> &out) const;
+
+    // Every pair (a < b) closer than radius, found in parallel over JobPool
+    void findPairs(float radius, std::vector<std::pair<uint32_t, uint32_t>> &out) const;
+
+private:
+    int cellX(float x) const;
+    int cellZ(float z) const;
+    uint32_t bucket(int cx, int cz) const;
+
+    // Visit each distinct bucket covering cells [cx0, cx1] x [cz0, cz1] once
+    template <typename Fn> void forBuckets(int cx0, int cz0, int cx1, int cz1, Fn fn) const;
+
+    float cell_, invCell_, originX_, originZ_;
+    uint32_t side_, shift_;           // buckets per side (1 << shift_)
+    std::vector<uint32_t> start_;     // bucket b holds sorted entries [start_[b], start_[b + 1])
+    std::vector<uint32_t> ids_;       // object ids sorted by bucket
+    std::vector<float> xs_, zs_;      // positions in the same order
+    std::vector<uint32_t> keys_;      // scratch: bucket per object
+};
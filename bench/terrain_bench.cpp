@@ -0,0 +1,489 @@
+// CPU terrain micro-benchmarks (no GL context needed).
+// Build and run with: make bench
+#include "../Nut/terrain/noise.h"
+#include "../Nut/terrain/normals.h"
+#include "../Nut/terrain/dem.h"
+#include "../Nut/terrain/heightfield.h"
+#include "../Nut/terrain/height_query.h"
+#include "../Nut/core/job_pool.h"
+#include "../Nut/core/profiler.h"
+#include "../Nut/world/agents.h"
+#include "../Nut/world/pathfinder.h"
+#include "../Nut/world/spatial_hash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using BenchClock = std::chrono::steady_clock;
+
+// Best-of-N wall time in milliseconds
+static double timeBest(int runs, const std::function<void()>& fn) {
+    double best = 1e30;
+    for (int r = 0; r < runs; ++r) {
+        auto t0 = BenchClock::now(); fn();
+        best = std::min(best, std::chrono::duration<double, std::milli>(BenchClock::now() - t0).count());
+    }
+    return best;
+}
+
+// Hardware cache-miss counter for the calling thread (reports -1 when perf
+// events are unavailable, e.g. in containers with perf_event_paranoid > 2)
+struct MissCounter {
+    int fd = -1;
+    MissCounter() {
+        perf_event_attr a; std::memset(&a, 0, sizeof(a));
+        a.type = PERF_TYPE_HARDWARE; a.size = sizeof(a); a.config = PERF_COUNT_HW_CACHE_MISSES;
+        a.disabled = 1; a.exclude_kernel = 1; a.exclude_hv = 1;
+        fd = (int)syscall(__NR_perf_event_open, &a, 0, -1, -1, 0);
+    }
+    ~MissCounter() { if (fd >= 0) close(fd); }
+    void start() { if (fd >= 0) { ioctl(fd, PERF_EVENT_IOC_RESET, 0); ioctl(fd, PERF_EVENT_IOC_ENABLE, 0); } }
+    long long stop() { long long v = -1; if (fd >= 0) { ioctl(fd, PERF_EVENT_IOC_DISABLE, 0); if (read(fd, &v, sizeof(v)) != sizeof(v)) v = -1; } return v; }
+};
+
+// Same height grid buildTerrainMesh generates (default scales)
+static std::vector<float> makeHeights(int N, float heightScale) {
+    std::vector<float> h((size_t)N * N);
+    JobPool::instance().parallelFor(0, (size_t)N, 16, [&](size_t z0, size_t z1) {
+        for (size_t z = z0; z < z1; ++z) for (int x = 0; x < N; ++x) h[z * N + x] = fbmNoise(x * 0.06f, z * 0.06f) * heightScale;
+    });
+    return h;
+}
+
+// makeHeights as a query grid centred on the origin, unit spacing (no pyramid)
+static std::shared_ptr<TerrainGrid> makeGrid(int N) {
+    std::shared_ptr<TerrainGrid> grid = std::make_shared<TerrainGrid>();
+    float half = (N - 1) * 0.5f;
+    grid->heights.resize(N, HeightLayout::RowMajor); grid->originX = grid->originZ = -half; grid->spacing = 1.0f;
+    std::vector<float> h = makeHeights(N, 6.0f); grid->heights.assignRowMajor(h.data());
+    return grid;
+}
+
+static void benchNormals() {
+    std::printf("== normals: accumulate (faces) vs stencil (SIMD, %u threads) ==\n", JobPool::instance().concurrency());
+    std::printf("%6s %12s %12s %8s %12s %12s\n", "N", "accum ms", "stencil ms", "speedup", "mean dev deg", "max dev deg");
+    const float scale = 1.0f;
+    for (int N : {256, 512, 1024, 2048, 4096}) {
+        std::vector<float> heights = makeHeights(N, 6.0f);
+        std::vector<glm::vec3> pos((size_t)N * N);
+        float half = (N - 1) * 0.5f * scale;
+        for (int z = 0; z < N; ++z) for (int x = 0; x < N; ++x) pos[(size_t)z * N + x] = glm::vec3(x * scale - half, heights[(size_t)z * N + x], z * scale - half);
+        std::vector<unsigned int> idx; idx.reserve((size_t)(N - 1) * (N - 1) * 6);
+        for (int z = 0; z < N - 1; ++z) for (int x = 0; x < N - 1; ++x) {
+            unsigned int tl = z * N + x, tr = tl + 1, bl = (z + 1) * N + x, br = bl + 1;
+            idx.insert(idx.end(), {tl, bl, br, tl, br, tr});
+        }
+
+        Heightfield hf(N, HeightLayout::RowMajor); hf.assignRowMajor(heights.data());
+        std::vector<glm::vec3> a(pos.size()), s(pos.size());
+        int runs = N >= 2048 ? 3 : 7;
+        double ta = timeBest(runs, [&] { computeNormalsAccumulate(pos.data(), pos.size(), idx.data(), idx.size(), a.data()); });
+        double ts = timeBest(runs, [&] { computeNormalsStencil(hf, scale, s.data()); });
+
+        // Visual difference: angle between the two normals per vertex
+        double sum = 0.0, worst = 0.0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            double d = std::acos(std::min(1.0f, std::max(-1.0f, glm::dot(a[i], s[i])))) * 57.29577951308232;
+            sum += d; worst = std::max(worst, d);
+        }
+        std::printf("%6d %12.2f %12.2f %7.1fx %12.3f %12.3f\n", N, ta, ts, ta / ts, sum / a.size(), worst);
+    }
+}
+
+// Row-major vs tiled Heightfield for the neighbour queries collision, normals and culling issue
+static void benchLayouts() {
+    std::printf("== heightfield layout: row-major vs tiled 8x8 (single thread, 1M queries) ==\n");
+    std::printf("%6s %-10s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "N", "layout", "bilin Mq/s", "misses", "walk Mq/s", "misses",
+                "3x3 Mq/s", "misses", "minmax32", "misses", "normals ms");
+    for (int N : {4096, 8192}) {
+        std::vector<float> src((size_t)N * N);
+        for (size_t i = 0; i < src.size(); ++i) src[i] = (float)((i * 2654435761u) & 0xffff) * (1.0f / 65535.0f);
+        for (HeightLayout layout : {HeightLayout::RowMajor, HeightLayout::Tiled}) {
+            Heightfield hf(N, layout); hf.assignRowMajor(src.data());
+            const int Q = 1000000;
+            std::vector<float> qx(Q), qz(Q);
+            std::mt19937 rng(1); std::uniform_real_distribution<float> u(0.0f, (float)(N - 1));
+            for (int i = 0; i < Q; ++i) { qx[i] = u(rng); qz[i] = u(rng); }
+            // Coherent pattern: 1000 walkers x 1000 short steps (agents / ray marching)
+            std::vector<float> wx(Q), wz(Q);
+            std::normal_distribution<float> step(0.0f, 0.7f);
+            for (int w = 0; w < Q / 1000; ++w) {
+                float x = u(rng), z = u(rng);
+                for (int i = 0; i < 1000; ++i) {
+                    x = std::min(std::max(x + step(rng), 0.0f), (float)(N - 1)); z = std::min(std::max(z + step(rng), 0.0f), (float)(N - 1));
+                    wx[w * 1000 + i] = x; wz[w * 1000 + i] = z;
+                }
+            }
+            MissCounter mc; volatile float sink = 0.0f;
+
+            mc.start();
+            double tb = timeBest(1, [&] { float acc = 0; for (int i = 0; i < Q; ++i) acc += hf.bilinear(qx[i], qz[i]); sink = acc; });
+            long long mb = mc.stop();
+
+            mc.start();
+            double tw = timeBest(1, [&] { float acc = 0; for (int i = 0; i < Q; ++i) acc += hf.bilinear(wx[i], wz[i]); sink = acc; });
+            long long mw = mc.stop();
+
+            mc.start();
+            double t3 = timeBest(1, [&] { float acc = 0, k[9]; for (int i = 0; i < Q; ++i) { hf.stencil3x3((int)qx[i], (int)qz[i], k); acc += k[0] + k[4] + k[8]; } sink = acc; });
+            long long m3 = mc.stop();
+
+            const int B = 100000; // 32x32 block reductions (LOD / culling bounds)
+            mc.start();
+            double tm = timeBest(1, [&] { float acc = 0, mn, mx; for (int i = 0; i < B; ++i) { int x = (int)qx[i] & ~31, z = (int)qz[i] & ~31; hf.minMax(x, z, x + 31, z + 31, mn, mx); acc += mx - mn; } sink = acc; });
+            long long mm = mc.stop();
+
+            std::vector<glm::vec3> nrm((size_t)N * N);
+            double tn = timeBest(2, [&] { computeNormalsStencil(hf, 1.0f, nrm.data()); });
+
+            std::printf("%6d %-10s %10.1f %10lld %10.1f %10lld %10.1f %10lld %8.1f/ms %10lld %10.1f\n", N, layout == HeightLayout::RowMajor ? "row-major" : "tiled",
+                        Q / tb / 1000.0, mb, Q / tw / 1000.0, mw, Q / t3 / 1000.0, m3, B / tm, mm, tn);
+            (void)sink;
+        }
+    }
+}
+
+// getTerrainHeight before (fbm per call) and after (cached grid with the mesh's triangle split)
+static void benchQueries() {
+    const int N = 512; const float scale = 1.0f, hs = 6.0f, half = (N - 1) * 0.5f * scale;
+    std::printf("== height queries: per-call fbm vs cached grid (%dx%d) ==\n", N, N);
+    std::shared_ptr<TerrainGrid> grid = makeGrid(N);
+
+    const int Q = 1000000;
+    std::vector<float> qx(Q), qz(Q);
+    std::mt19937 rng(3); std::uniform_real_distribution<float> u(-half, half);
+    for (int i = 0; i < Q; ++i) { qx[i] = u(rng); qz[i] = u(rng); }
+    volatile float sink = 0.0f;
+    double tf = timeBest(1, [&] { float acc = 0; for (int i = 0; i < Q; ++i) acc += fbmNoise((qx[i] + half) / scale * 0.06f, (qz[i] + half) / scale * 0.06f) * hs; sink = acc; });
+    double tg = timeBest(3, [&] { float acc = 0; for (int i = 0; i < Q; ++i) acc += grid->height(qx[i], qz[i]); sink = acc; });
+
+    // How far the old per-call fbm drifted from the drawn surface
+    double maxDev = 0.0, sumDev = 0.0;
+    for (int i = 0; i < Q; ++i) {
+        double d = std::fabs(fbmNoise((qx[i] + half) / scale * 0.06f, (qz[i] + half) / scale * 0.06f) * hs - grid->height(qx[i], qz[i]));
+        maxDev = std::max(maxDev, d); sumDev += d;
+    }
+    std::printf("fbm: %.1f ns/query, grid: %.1f ns/query (%.0fx), fbm vs drawn surface: mean %.3f max %.3f units (sink %.1f)\n",
+                tf * 1e6 / Q, tg * 1e6 / Q, tf / tg, sumDev / Q, maxDev, (float)sink);
+}
+
+// Batched SoA heights + normals: scalar loop vs SIMD batch vs SIMD batch over the job pool
+static void benchBatch() {
+    const int N = 1024; const float half = (N - 1) * 0.5f;
+    std::printf("== batched height+normal queries (%dx%d grid, %u threads), Mq/s ==\n", N, N, JobPool::instance().concurrency());
+    std::printf("%9s %10s %10s %10s %12s\n", "points", "scalar", "simd", "simd+pool", "max |dh|");
+    std::shared_ptr<TerrainGrid> grid = makeGrid(N);
+    HeightQuery query; query.publish(grid);
+
+    for (size_t count : {(size_t)1000, (size_t)10000, (size_t)100000, (size_t)1000000}) {
+        std::vector<float> xs(count), zs(count), hs(count), nx(count), ny(count), nz(count), ref(count);
+        std::mt19937 rng(5); std::uniform_real_distribution<float> u(-half - 4.0f, half + 4.0f);
+        for (size_t i = 0; i < count; ++i) { xs[i] = u(rng); zs[i] = u(rng); }
+        int runs = count < 100000 ? 50 : 5;
+        double ts = timeBest(runs, [&] { for (size_t i = 0; i < count; ++i) { ref[i] = grid->height(xs[i], zs[i]); glm::vec3 n = grid->normal(xs[i], zs[i]); nx[i] = n.x; ny[i] = n.y; nz[i] = n.z; } });
+        double tv = timeBest(runs, [&] { grid->queryBatch(xs.data(), zs.data(), count, hs.data(), nx.data(), ny.data(), nz.data()); });
+        double tp = timeBest(runs, [&] { query.queryBatch(xs.data(), zs.data(), count, hs.data(), nx.data(), ny.data(), nz.data()); });
+        float dh = 0.0f; for (size_t i = 0; i < count; ++i) dh = std::max(dh, std::fabs(hs[i] - ref[i]));
+        std::printf("%9zu %10.1f %10.1f %10.1f %12.2e\n", count, count / ts / 1000.0, count / tv / 1000.0, count / tp / 1000.0, dh);
+    }
+}
+
+// Reference raycast: 2D DDA over every cell on the ray's path, Moller-Trumbore
+// against the cell's two mesh triangles. Exact but visits every cell.
+static bool raycastDDA(const TerrainGrid &g, glm::vec3 o, glm::vec3 d, float maxT, float &tHit) {
+    const int cells = g.heights.size() - 1;
+    auto vert = [&](int x, int z) { return glm::vec3(g.originX + x * g.spacing, g.heights.at(x, z), g.originZ + z * g.spacing); };
+    auto tri = [&](glm::vec3 a, glm::vec3 b, glm::vec3 c, float &t) {
+        glm::vec3 e1 = b - a, e2 = c - a, p = glm::cross(d, e2); float det = glm::dot(e1, p);
+        if (std::fabs(det) < 1e-12f) return false;
+        float inv = 1.0f / det; glm::vec3 s = o - a; float u = glm::dot(s, p) * inv; if (u < -1e-5f || u > 1.0f + 1e-5f) return false;
+        glm::vec3 q = glm::cross(s, e1); float v = glm::dot(d, q) * inv; if (v < -1e-5f || u + v > 1.0f + 1e-5f) return false;
+        t = glm::dot(e2, q) * inv; return t >= 0.0f && t <= maxT;
+    };
+    float gx = (o.x - g.originX) / g.spacing, gz = (o.z - g.originZ) / g.spacing;
+    int cx = (int)std::floor(gx), cz = (int)std::floor(gz);
+    int sx = d.x > 0 ? 1 : -1, sz = d.z > 0 ? 1 : -1;
+    float dx = d.x / g.spacing, dz = d.z / g.spacing;
+    float tdx = dx != 0 ? std::fabs(1.0f / dx) : 1e30f, tdz = dz != 0 ? std::fabs(1.0f / dz) : 1e30f;
+    float tx = dx != 0 ? ((sx > 0 ? cx + 1 - gx : gx - cx) * tdx) : 1e30f, tz = dz != 0 ? ((sz > 0 ? cz + 1 - gz : gz - cz) * tdz) : 1e30f;
+    float t = 0.0f;
+    while (t <= maxT) {
+        if (cx >= 0 && cz >= 0 && cx < cells && cz < cells) {
+            float best = 1e30f, tt;
+            glm::vec3 tl = vert(cx, cz), tr = vert(cx + 1, cz), bl = vert(cx, cz + 1), br = vert(cx + 1, cz + 1);
+            if (tri(tl, bl, br, tt)) best = std::min(best, tt);
+            if (tri(tl, br, tr, tt)) best = std::min(best, tt);
+            if (best < 1e30f) { tHit = best; return true; }
+        } else if ((sx > 0 ? cx >= cells : cx < 0) || (sz > 0 ? cz >= cells : cz < 0)) return false;
+        if (tx < tz) { t = tx; tx += tdx; cx += sx; } else { t = tz; tz += tdz; cz += sz; }
+    }
+    return false;
+}
+
+// Raycasts at 4096^2: min/max pyramid vs a per-cell DDA and a fixed-step march
+static void benchRaycast() {
+    const int N = 4096; const float half = (N - 1) * 0.5f;
+    std::printf("== terrain raycast (%dx%d grid) ==\n", N, N);
+    std::shared_ptr<TerrainGrid> grid = makeGrid(N);
+    double tb = timeBest(1, [&] { grid->buildPyramid(); });
+    std::printf("pyramid build: %.1f ms, %d levels, %.1f MB\n", tb, grid->pyramid.levels(), grid->pyramid.storageBytes() / 1048576.0);
+
+    // Picking rays (from 30 units above, 10-60 degrees down) and eye-level
+    // sight lines (1.7 above the ground, within 3 degrees of horizontal)
+    struct Ray { glm::vec3 o, d; };
+    const int R = 20000; const float maxT = 400.0f;
+    std::mt19937 rng(11); std::uniform_real_distribution<float> u(-half * 0.9f, half * 0.9f), ang(0.0f, 6.2831853f);
+    for (int kind = 0; kind < 2; ++kind) {
+        std::uniform_real_distribution<float> pitch(kind == 0 ? -1.05f : -0.05f, kind == 0 ? -0.17f : 0.05f);
+        std::vector<Ray> rays(R);
+        for (Ray &r : rays) {
+            float x = u(rng), z = u(rng), a = ang(rng), p = pitch(rng);
+            r.o = glm::vec3(x, grid->height(x, z) + (kind == 0 ? 30.0f : 1.7f), z);
+            r.d = glm::vec3(std::cos(a) * std::cos(p), std::sin(p), std::sin(a) * std::cos(p));
+        }
+        int hits = 0, mismatch = 0; float maxErr = 0.0f; RayHit hit;
+        double tp = timeBest(3, [&] { hits = 0; for (const Ray &r : rays) hits += grid->raycast(r.o, r.d, maxT, hit); });
+        double td = timeBest(1, [&] { float t; for (const Ray &r : rays) { volatile bool b = raycastDDA(*grid, r.o, r.d, maxT, t); (void)b; } });
+        double tm = timeBest(1, [&] { for (const Ray &r : rays) { for (float t = 0.0f; t <= maxT; t += 0.25f) { glm::vec3 p = r.o + r.d * t; if (p.y <= grid->height(p.x, p.z)) break; } } });
+        for (const Ray &r : rays) {
+            float t; bool a = grid->raycast(r.o, r.d, maxT, hit), b = raycastDDA(*grid, r.o, r.d, maxT, t);
+            if (a != b) ++mismatch; else if (a) maxErr = std::max(maxErr, std::fabs(hit.t - t));
+        }
+        std::printf("%s: %d/%d hit | pyramid %.3f us/ray, cell DDA %.3f us/ray, 0.25-step march %.3f us/ray | hit/miss mismatches %d, max |dt| %.2e\n",
+                    kind == 0 ? "picking  " : "eye-level", hits, R, tp * 1e3 / R, td * 1e3 / R, tm * 1e3 / R, mismatch, maxErr);
+    }
+}
+
+// Agent visibility: per-pair lineOfSight loop vs the sorted, pooled batch
+static void benchLineOfSight() {
+    const int N = 4096;
+    std::printf("== batched line of sight (%dx%d grid, %u threads) ==\n", N, N, JobPool::instance().concurrency());
+    std::shared_ptr<TerrainGrid> grid = makeGrid(N); grid->buildPyramid();
+    HeightQuery query; query.publish(grid);
+
+    // Agents at eye height scattered over a 1024-unit area, pairs up to 150 units apart
+    for (size_t count : {(size_t)1000, (size_t)10000, (size_t)100000}) {
+        std::vector<glm::vec3> from(count), to(count);
+        std::mt19937 rng(13); std::uniform_real_distribution<float> u(-512.0f, 512.0f), r(-150.0f, 150.0f);
+        for (size_t i = 0; i < count; ++i) {
+            float x = u(rng), z = u(rng), x2 = x + r(rng), z2 = z + r(rng);
+            from[i] = glm::vec3(x, grid->height(x, z) + 1.7f, z); to[i] = glm::vec3(x2, grid->height(x2, z2) + 1.7f, z2);
+        }
+        std::vector<uint64_t> bits((count + 63) / 64), ref((count + 63) / 64);
+        double ts = timeBest(2, [&] {
+            std::fill(ref.begin(), ref.end(), 0ull);
+            for (size_t i = 0; i < count; ++i) if (grid->lineOfSight(from[i], to[i])) ref[i / 64] |= 1ull << (i % 64);
+        });
+        double tb = timeBest(3, [&] { query.lineOfSightBatch(from.data(), to.data(), count, bits.data()); });
+        size_t visible = 0, diff = 0;
+        for (size_t w = 0; w < bits.size(); ++w) { visible += (size_t)__builtin_popcountll(bits[w]); diff += (size_t)__builtin_popcountll(bits[w] ^ ref[w]); }
+        std::printf("%7zu pairs: single %.3f us/pair, batch %.3f us/pair (%.1fx) | %zu visible, %zu differ\n",
+                    count, ts * 1e3 / count, tb * 1e3 / count, ts / tb, visible, diff);
+    }
+}
+
+// Agent scene: wandering terrain walkers with occasional jumps, 60 Hz ticks
+static void benchAgents() {
+    const int N = 1024; const float half = (N - 1) * 0.5f;
+    std::printf("== agents: movement + gravity + terrain snap (%dx%d grid, %u threads) ==\n", N, N, JobPool::instance().concurrency());
+    std::shared_ptr<TerrainGrid> grid = makeGrid(N);
+
+    for (size_t count : {(size_t)10000, (size_t)100000, (size_t)1000000}) {
+        Agents agents; agents.reserve(count);
+        std::mt19937 rng(17); std::uniform_real_distribution<float> u(-half, half), ang(0.0f, 6.2831853f), spd(1.0f, 11.4f);
+        for (size_t i = 0; i < count; ++i) { float x = u(rng), z = u(rng); agents.spawn(glm::vec3(x, grid->height(x, z) + 1.7f, z), ang(rng), spd(rng)); }
+        const int ticks = count >= 1000000 ? 20 : 200; const float dt = 1.0f / 60.0f;
+        std::uniform_int_distribution<size_t> pick(0, count - 1);
+        double total = 0.0, worst = 0.0;
+        for (int t = 0; t < ticks; ++t) {
+            for (size_t j = 0; j < count / 100; ++j) agents.jump(pick(rng), 7.0f); // ~1% jump per tick
+            auto t0 = BenchClock::now();
+            agents.update(*grid, dt);
+            double ms = std::chrono::duration<double, std::milli>(BenchClock::now() - t0).count();
+            total += ms; worst = std::max(worst, ms);
+        }
+        size_t air = 0; for (size_t i = 0; i < count; ++i) air += agents.airborne(i);
+        std::printf("%8zu agents: %.3f ms/tick avg, %.3f ms worst, %.1f ns/agent (%zu airborne)\n",
+                    count, total / ticks, worst, total / ticks * 1e6 / count, air);
+    }
+}
+
+// Spatial hash broadphase: rebuild, radius/box queries and all-pairs over a
+// 1024^2 area (radius 2, cells of 4 units = 16 per terrain patch side)
+static void benchSpatialHash() {
+    std::printf("== spatial hash broadphase (%u threads) ==\n", JobPool::instance().concurrency());
+    for (size_t count : {(size_t)10000, (size_t)100000, (size_t)1000000}) {
+        std::vector<float> xs(count), zs(count);
+        std::mt19937 rng(19); std::uniform_real_distribution<float> u(-512.0f, 512.0f);
+        for (size_t i = 0; i < count; ++i) { xs[i] = u(rng); zs[i] = u(rng); }
+        SpatialHash hash(4.0f, -511.5f, -511.5f);
+        double tb = timeBest(3, [&] { hash.build(xs.data(), zs.data(), count); });
+
+        const int Q = 10000; std::vector<uint32_t> found; size_t hits = 0;
+        double tq = timeBest(3, [&] { hits = 0; for (int q = 0; q < Q; ++q) { found.clear(); hash.queryRadius(xs[q % count], zs[q % count], 8.0f, found); hits += found.size(); } });
+        double ta = timeBest(3, [&] { for (int q = 0; q < Q; ++q) { found.clear(); hash.queryBox(xs[q % count] - 8.0f, zs[q % count] - 8.0f, xs[q % count] + 8.0f, zs[q % count] + 8.0f, found); } });
+
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        double tp = timeBest(3, [&] { hash.findPairs(2.0f, pairs); });
+        std::printf("%8zu objects: rebuild %.2f ms, radius-8 query %.2f us (%.1f found), box query %.2f us, pairs(r=2) %.2f ms -> %zu pairs",
+                    count, tb, tq * 1e3 / Q, (double)hits / Q, ta * 1e3 / Q, tp, pairs.size());
+        if (count <= 10000) {
+            // Brute-force check of the pair set
+            size_t brute = 0;
+            for (size_t i = 0; i < count; ++i) for (size_t j = i + 1; j < count; ++j) { float dx = xs[i] - xs[j], dz = zs[i] - zs[j]; brute += dx * dx + dz * dz <= 4.0f; }
+            std::printf(" (brute force %zu)", brute);
+        }
+        std::printf("\n");
+    }
+}
+
+// Reference: plain A* over the whole grid with the same step costs as
+// PathFinder (NavParams defaults); returns the path cost or -1
+static float flatAStar(const TerrainGrid &g, int src, int dst) {
+    const NavParams p; const int N = g.heights.size();
+    const int DX[8] = {1, -1, 0, 0, 1, 1, -1, -1}, DZ[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+    auto est = [&](int a) { int dx = std::abs(a % N - dst % N), dz = std::abs(a / N - dst / N); return g.spacing * (std::max(dx, dz) + 0.41421356f * std::min(dx, dz)); };
+    std::vector<float> cost((size_t)N * N, 1e30f); std::vector<uint8_t> closed((size_t)N * N, 0);
+    std::priority_queue<std::pair<float, int>, std::vector<std::pair<float, int>>, std::greater<std::pair<float, int>>> open;
+    cost[src] = 0.0f; open.push({est(src), src});
+    while (!open.empty()) {
+        int u = open.top().second; open.pop();
+        if (closed[u]) continue;
+        closed[u] = 1;
+        if (u == dst) return cost[u];
+        int x = u % N, z = u / N;
+        for (int d = 0; d < 8; ++d) {
+            int nx = x + DX[d], nz = z + DZ[d];
+            if (nx < 0 || nz < 0 || nx >= N || nz >= N) continue;
+            float len = (DX[d] && DZ[d]) ? g.spacing * 1.41421356f : g.spacing;
+            float s = std::fabs(g.heights.at(nx, nz) - g.heights.at(x, z)) / len;
+            if (s > p.maxSlope) continue;
+            float c = cost[u] + len * (1.0f + p.slopePenalty * s);
+            if (c < cost[nz * N + nx]) { cost[nz * N + nx] = c; open.push({c + est(nz * N + nx), nz * N + nx}); }
+        }
+    }
+    return -1.0f;
+}
+
+static void benchPathfinding() {
+    const int N = 1024; const float half = (N - 1) * 0.5f;
+    std::printf("== HPA* pathfinding (%dx%d grid, 32x32 clusters, %u threads) ==\n", N, N, JobPool::instance().concurrency());
+    std::shared_ptr<TerrainGrid> grid = makeGrid(N);
+
+    PathFinder paths;
+    double tb = timeBest(1, [&] { paths.build(grid); });
+
+    // Raise a 24x24 mound and rebuild only around it
+    auto edited = std::make_shared<TerrainGrid>(*grid);
+    for (int z = 500; z < 524; ++z) for (int x = 500; x < 524; ++x) edited->heights.at(x, z) += 3.0f;
+    double tu = timeBest(1, [&] { paths.updateRegion(edited, 500, 500, 523, 523); });
+    std::printf("build %.1f ms (%zu abstract nodes), 24x24 region update %.2f ms\n", tb, paths.abstractNodes(), tu);
+    paths.build(grid);
+
+    const int Q = 200;
+    std::vector<PathFinder::Request> reqs(Q);
+    std::mt19937 rng(23); std::uniform_real_distribution<float> u(-half, half);
+    for (auto &r : reqs) { r.from = glm::vec3(u(rng), 0.0f, u(rng)); r.to = glm::vec3(u(rng), 0.0f, u(rng)); }
+    std::vector<glm::vec3> one; std::vector<std::vector<glm::vec3>> many;
+    double ts = timeBest(2, [&] { for (auto &r : reqs) paths.findPath(r.from, r.to, one); });
+    double tp = timeBest(2, [&] { paths.findPaths(reqs.data(), reqs.size(), many); });
+
+    // Path quality and completeness against flat A* on a subset
+    const int R = 40; int agree = 0, found = 0; double ratio = 0.0;
+    auto sample = [&](const glm::vec3 &p) { return (int)std::lround(p.z + half) * N + (int)std::lround(p.x + half); };
+    double tf = timeBest(1, [&] {
+        for (int i = 0; i < R; ++i) {
+            float ref = flatAStar(*grid, sample(reqs[i].from), sample(reqs[i].to));
+            bool ok = !many[i].empty();
+            agree += ok == (ref >= 0.0f);
+            if (ok && ref > 0.0f) {
+                float c = 0.0f;
+                for (size_t k = 1; k < many[i].size(); ++k) {
+                    glm::vec3 a = many[i][k - 1], b = many[i][k];
+                    float len = std::sqrt((b.x - a.x) * (b.x - a.x) + (b.z - a.z) * (b.z - a.z));
+                    c += len * (1.0f + NavParams().slopePenalty * std::fabs(b.y - a.y) / len);
+                }
+                ratio += c / ref; ++found;
+            }
+        }
+    });
+    std::printf("%d paths: %.3f ms/path serial, %.3f ms/path batched | flat A* %.2f ms/path; reachability agrees %d/%d, HPA* cost %.3fx optimal\n",
+                Q, ts / Q, tp / Q, tf / R, agree, R, found ? ratio / found : 0.0);
+}
+
+static void benchDem() {
+    // Synthetic 16-bit raw DEM written to /tmp, then imported and queried under a small budget
+    const int64_t N = 4096; const char* path = "/tmp/nut_bench_dem.raw";
+    std::printf("== DEM tiles: %lldx%lld raw import + paged sampling ==\n", (long long)N, (long long)N);
+    {
+        FILE* f = std::fopen(path, "wb"); if (!f) { std::printf("cannot write %s\n", path); return; }
+        std::vector<uint16_t> row((size_t)N);
+        for (int64_t z = 0; z < N; ++z) {
+            for (int64_t x = 0; x < N; ++x) row[x] = (uint16_t)((fbmNoise(x * 0.01f, z * 0.01f) * 0.25f + 0.5f) * 65535.0f);
+            std::fwrite(row.data(), sizeof(uint16_t), row.size(), f);
+        }
+        std::fclose(f);
+        std::remove("/tmp/nut_bench_dem.raw.pyr");
+    }
+    DemTileStore store; store.setResidentBudget(16u << 20);
+    double ti = timeBest(1, [&] { store.import(path); });
+    std::printf("import (tiles + %d mip levels): %.1f ms\n", store.levels(), ti);
+
+    std::mt19937 rng(7); std::uniform_real_distribution<double> u(0.0, (double)(N - 1));
+    const int Q = 1000000; float sink = 0.0f;
+    double tr = timeBest(1, [&] { for (int i = 0; i < Q; ++i) sink += store.sample(u(rng), u(rng)); });
+    double tl = timeBest(1, [&] { double x = 100, z = 100; for (int i = 0; i < Q; ++i) { x += 0.37; z += 0.11; sink += store.sample(x, z); } });
+    std::vector<float> window(512 * 512);
+    double tw = timeBest(3, [&] { store.readRegion(0, 1800, 1800, 512, 512, window.data()); });
+    std::printf("random sample: %.1f ns/query, walking sample: %.1f ns/query, 512^2 window: %.2f ms, resident %.1f MB (sink %.1f)\n",
+                tr * 1e6 / Q, tl * 1e6 / Q, tw, store.residentBytes() / 1048576.0, sink);
+    std::remove(path); std::remove("/tmp/nut_bench_dem.raw.pyr");
+}
+
+// Cost of one scoped zone (two timestamps + one ring write) against the
+// same loop without zones, nested two deep, then a full-ring trace export
+static void benchProfiler() {
+    std::printf("== CPU profiler zones (NUT_PROFILE=%d) ==\n", NUT_PROFILE);
+    const int N = 2000000; volatile uint32_t sink = 0;
+    double base = timeBest(5, [&] { for (int i = 0; i < N; ++i) { sink = sink + i; sink = sink ^ i; } });
+    double zoned = timeBest(5, [&] {
+        for (int i = 0; i < N; ++i) {
+            PROFILE_ZONE("outer");
+            sink = sink + i;
+            { PROFILE_ZONE("inner"); sink = sink ^ i; }
+        }
+    });
+    std::printf("%.1f ns per zone (%d nested zones, loop alone %.2f ms)\n", (zoned - base) * 1e6 / (2.0 * N), 2 * N, base);
+    const char* path = "/tmp/nut_bench_trace.json";
+    double te = timeBest(1, [&] { Profiler::writeChromeTrace(path); });
+    std::printf("trace export (%zu threads, %zu-event rings): %.1f ms\n", Profiler::threadCount(), Profiler::RING_EVENTS, te);
+    std::remove(path);
+}
+
+int main() {
+    benchNormals();
+    benchLayouts();
+    benchQueries();
+    benchBatch();
+    benchRaycast();
+    benchLineOfSight();
+    benchAgents();
+    benchSpatialHash();
+    benchPathfinding();
+    benchDem();
+    benchProfiler();
+    return 0;
+}
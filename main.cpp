@@ -1,9 +1,51 @@
 #include "Nut/Nut.h"
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <string>
 
-int main() {
+int main(int argc, char** argv) {
     Engine engine;
 
+    // Reproducible runs: --record <file>, --replay <file>, --timing-log <file.csv>;
+    // --trace <file.json> writes the CPU profile at exit.
+    // Scripted flythrough: --flythrough <frames> (1280x720 window) or
+    // --headless <frames> [--size <W>x<H>] (EGL, offscreen), then
+    // [--camera-path <file>] [--report <file.json>] [--baseline <file.json>] [--threshold <percent>]
+    // [--dynamic-res <GPU budget ms>] (interactive runs always scale to 14 ms)
+    // --render-thread 0 draws on the main thread (input latency comparison)
+    int flythroughFrames = 0, width = 1280, height = 720;
+    bool headless = false;
+    std::string cameraPath, baseline;
+    double threshold = 10.0;
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--record") engine.recordInput(argv[++i]);
+        else if (arg == "--replay") { if (!engine.replayInput(argv[++i])) return -1; }
+        else if (arg == "--timing-log") engine.setFrameTimingLog(argv[++i]);
+        else if (arg == "--trace") engine.setTracePath(argv[++i]);
+        else if (arg == "--flythrough") flythroughFrames = std::atoi(argv[++i]);
+        else if (arg == "--headless") { flythroughFrames = std::atoi(argv[++i]); headless = true; }
+        else if (arg == "--size") std::sscanf(argv[++i], "%dx%d", &width, &height);
+        else if (arg == "--camera-path") cameraPath = argv[++i];
+        else if (arg == "--report") engine.setBenchReport(argv[++i]);
+        else if (arg == "--baseline") baseline = argv[++i];
+        else if (arg == "--threshold") threshold = std::atof(argv[++i]);
+        else if (arg == "--render-thread") engine.setRenderThread(std::atoi(argv[++i]) != 0);
+        else if (arg == "--dynamic-res") { engine.setDynamicResolution(true); engine.setResolutionTargetMs((float)std::atof(argv[++i])); }
+    }
+    if (!baseline.empty()) engine.setBenchBaseline(baseline, threshold);
+
+    if (flythroughFrames > 0) {
+        if (headless ? !engine.initHeadless(width, height) : !engine.init(false)) { std::cerr << "Failed to initialize engine\n"; return -1; }
+        engine.load_terrain_using_texture("assets/grass.png");
+        engine.panorama("assets/qwantani_moon_noon_puresky_4k.hdr");
+        CameraPath path;
+        if (cameraPath.empty()) path = engine.defaultFlightPath();
+        else if (!path.load(cameraPath)) return -1;
+        return engine.runFlythrough(path, flythroughFrames) ? 0 : 1;
+    }
+
     // Initialize the engine (fullscreen by default). If you want windowed, pass false.
     if (!engine.init(true)) {
         std::cerr << "Failed to initialize engine\n";
@@ -21,6 +63,9 @@ int main() {
     // Toggle vsync if desired
     engine.vsync(true);
 
+    // Scale the 3D scene to keep the GPU inside a 60 Hz frame
+    engine.setDynamicResolution(true);
+
     // Enter the engine main loop
     engine.mainloop();
 